@@ -0,0 +1,47 @@
+#include "AlphaMask.hpp"
+
+#include <algorithm>
+
+namespace
+{
+	// Barely visible anti aliased edges and shadows shouldn't steal clicks from the layers below
+	constexpr uint8_t MIN_VISIBLE_ALPHA{ 16 };
+
+	// Keeps the mask of even the biggest images at 128 KiB, a block is still smaller than a pixel on screen at that point
+	constexpr int MAX_MASK_SIZE{ 1024 };
+}
+
+AlphaMask::AlphaMask(const ImageCache::Pixels& pixels)
+{
+	if (pixels.width <= 0 || pixels.height <= 0) return;
+
+	const int block_size = (std::max<int>(pixels.width, pixels.height) + MAX_MASK_SIZE - 1) / MAX_MASK_SIZE;
+	width = (pixels.width + block_size - 1) / block_size;
+	height = (pixels.height + block_size - 1) / block_size;
+
+	words_per_row = (static_cast<size_t>(width) + 63) / 64;
+	bits.assign(words_per_row * static_cast<size_t>(height), 0);
+
+	const uint8_t* alpha = pixels.data.data() + 3;
+	for (int y = 0; y < pixels.height; y++)
+	{
+		uint64_t* row = bits.data() + static_cast<size_t>(y / block_size) * words_per_row;
+		for (int x = 0; x < pixels.width; x++, alpha += 4)
+		{
+			if (*alpha < MIN_VISIBLE_ALPHA) continue;
+
+			const size_t mask_x = static_cast<size_t>(x / block_size);
+			row[mask_x / 64] |= uint64_t{ 1 } << (mask_x % 64);
+		}
+	}
+}
+
+bool AlphaMask::IsVisible(const float u, const float v) const
+{
+	if (IsEmpty()) return true;
+	if (u < 0.0f || u >= 1.0f || v < 0.0f || v >= 1.0f) return false;
+
+	const size_t x = static_cast<size_t>(std::min<int>(static_cast<int>(u * static_cast<float>(width)), width - 1));
+	const size_t y = static_cast<size_t>(std::min<int>(static_cast<int>(v * static_cast<float>(height)), height - 1));
+	return (bits.at(y * words_per_row + x / 64) >> (x % 64)) & 1;
+}
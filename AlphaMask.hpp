@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ImageCache.hpp"
+
+// One bit for every pixel telling whether it is visible enough to click on, so layers get picked by their pixels instead of their rect.
+// Big images get one bit for every block of pixels, which is set when any pixel in the block is visible
+class AlphaMask
+{
+public:
+	AlphaMask() = default;
+	explicit AlphaMask(const ImageCache::Pixels& pixels);
+
+	// Masks that weren't made (yet) count every pixel as visible
+	[[nodiscard]] bool IsEmpty() const { return bits.empty(); }
+
+	// u and v go from 0 to 1 over the image, anything outside that is never visible
+	[[nodiscard]] bool IsVisible(float u, float v) const;
+
+private:
+	int width{ 0 };
+	int height{ 0 };
+
+	// Every row starts at a new word
+	size_t words_per_row{ 0 };
+	std::vector<uint64_t> bits;
+};
@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include <stb_image_resize2.h>
+
+#include "ImageExport.hpp"
+#include "ImageResize.hpp"
+#include "PngWriter.hpp"
+#include "ThreadPool.hpp"
+
+// Times the heavy image work on a made up banner, for every thread count from 1 up to all of them.
+// Run the Release build, Debug timings say little about the real thing
+namespace
+{
+	constexpr int SOURCE_WIDTH{ 4096 };
+	constexpr int SOURCE_HEIGHT{ 4096 };
+
+	// The usual case, a big photo scaled down to fit the canvas
+	constexpr int RESIZED_WIDTH{ 1536 };
+	constexpr int RESIZED_HEIGHT{ 1536 };
+
+	// Enlarging uses other filters than shrinking, so the presets get timed both ways
+	constexpr int ENLARGE_SOURCE_SIZE{ 1024 };
+	constexpr int ENLARGED_SIZE{ 2560 };
+
+	// The size of a wide banner, like one with a lot of time zones
+	constexpr int EXPORT_WIDTH{ 8000 };
+	constexpr int EXPORT_HEIGHT{ 2000 };
+	constexpr const char* EXPORT_PATH{ "TimezoneBannerBench.png" };
+	constexpr const char* EXPORT_STEM{ "TimezoneBannerBench" };
+
+	// Every timing is the fastest of this many runs, so a hiccup somewhere else doesn't end up in the numbers
+	constexpr int RUNS{ 3 };
+
+	// Gradients with some noise and hard edged blocks, so filters and compressors have something like a real banner to chew on
+	std::vector<uint8_t> MakeSourcePixels(const int width, const int height)
+	{
+		std::vector<uint8_t> pixels(static_cast<size_t>(width) * static_cast<size_t>(height) * 4);
+
+		uint32_t random = 12345;
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				random = random * 1664525u + 1013904223u;
+				const int noise = static_cast<int>(random >> 28) - 8;
+				const bool block = ((x / 97) + (y / 61)) % 5 == 0;
+
+				uint8_t* pixel = pixels.data() + (static_cast<size_t>(y) * static_cast<size_t>(width) + static_cast<size_t>(x)) * 4;
+				pixel[0] = static_cast<uint8_t>(std::clamp<int>(x * 255 / width + noise, 0, 255));
+				pixel[1] = static_cast<uint8_t>(std::clamp<int>(y * 255 / height + noise, 0, 255));
+				pixel[2] = block ? 230 : static_cast<uint8_t>((x ^ y) & 0xFF);
+				pixel[3] = block && (x / 97) % 2 == 0 ? 0 : 255;
+			}
+		}
+
+		return pixels;
+	}
+
+	double TimeMilliseconds(const std::function<void()>& function)
+	{
+		double best = 0.0;
+		for (int run = 0; run < RUNS; run++)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			function();
+			const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			best = run == 0 ? milliseconds : std::min<double>(best, milliseconds);
+		}
+
+		return best;
+	}
+
+	// Colors are weighed by their alpha first, what's under fully transparent pixels doesn't matter for how it looks
+	double GetPsnr(const std::vector<uint8_t>& pixels, const std::vector<uint8_t>& reference)
+	{
+		double squared_error = 0.0;
+		for (size_t i = 0; i < pixels.size(); i += 4)
+		{
+			for (size_t channel = 0; channel < 4; channel++)
+			{
+				const double value = channel == 3 ? pixels.at(i + 3) : pixels.at(i + channel) * pixels.at(i + 3) / 255.0;
+				const double reference_value = channel == 3 ? reference.at(i + 3) : reference.at(i + channel) * reference.at(i + 3) / 255.0;
+				squared_error += (value - reference_value) * (value - reference_value);
+			}
+		}
+
+		if (squared_error == 0.0) return std::numeric_limits<double>::infinity();
+		return 10.0 * std::log10(255.0 * 255.0 / (squared_error / static_cast<double>(pixels.size())));
+	}
+
+	void BenchResizeThreads(const std::vector<uint8_t>& source, const size_t max_threads)
+	{
+		std::cout << std::format("Resize {}x{} to {}x{}, high quality\n", SOURCE_WIDTH, SOURCE_HEIGHT, RESIZED_WIDTH, RESIZED_HEIGHT);
+		std::cout << "threads        ms   speedup\n";
+
+		std::vector<uint8_t> output(static_cast<size_t>(RESIZED_WIDTH) * static_cast<size_t>(RESIZED_HEIGHT) * 4);
+		double single_thread = 0.0;
+		for (size_t threads = 1; threads <= max_threads; threads++)
+		{
+			ThreadPool::SetThreadLimit(threads);
+			const double milliseconds = TimeMilliseconds([&] { ImageResize::Resize(source.data(), SOURCE_WIDTH, SOURCE_HEIGHT, output.data(), RESIZED_WIDTH, RESIZED_HEIGHT); });
+			if (threads == 1) single_thread = milliseconds;
+
+			std::cout << std::format("{:7} {:9.1f} {:8.2f}x\n", threads, milliseconds, single_thread / milliseconds);
+		}
+
+		ThreadPool::SetThreadLimit(0);
+		std::cout << '\n';
+	}
+
+	// Every preset with and without sRGB and premultiplied alpha on all threads. PSNR is against high quality with the same options,
+	// so it shows what the faster filters lose and not the (intended) difference sRGB makes
+	void BenchResizePresets(const std::vector<uint8_t>& source, const int source_width, const int source_height, const int output_width, const int output_height)
+	{
+		std::cout << std::format("Resize presets, {}x{} to {}x{}\n", source_width, source_height, output_width, output_height);
+		std::cout << "preset          srgb  premultiply        ms   PSNR (dB)\n";
+
+		const size_t output_size = static_cast<size_t>(output_width) * static_cast<size_t>(output_height) * 4;
+		for (const bool srgb : { false, true })
+		{
+			for (const bool premultiply_alpha : { false, true })
+			{
+				std::vector<uint8_t> reference(output_size);
+				ImageResize::Resize(source.data(), source_width, source_height, reference.data(), output_width, output_height, { ImageResize::Quality::HighQuality, srgb, premultiply_alpha });
+
+				for (size_t i = 0; i < ImageResize::QUALITY_NAMES.size(); i++)
+				{
+					const ImageResize::Settings settings{ static_cast<ImageResize::Quality>(i), srgb, premultiply_alpha };
+
+					std::vector<uint8_t> output(output_size);
+					const double milliseconds = TimeMilliseconds([&] { ImageResize::Resize(source.data(), source_width, source_height, output.data(), output_width, output_height, settings); });
+
+					const std::string psnr = settings.quality == ImageResize::Quality::HighQuality ? "reference" : std::format("{:.2f}", GetPsnr(output, reference));
+					std::cout << std::format("{:14} {:>5} {:>12} {:9.1f} {:>11}\n", ImageResize::QUALITY_NAMES.at(i), srgb ? "yes" : "no", premultiply_alpha ? "yes" : "no", milliseconds, psnr);
+				}
+			}
+		}
+
+		std::cout << '\n';
+	}
+
+	// Otherwise every run after the first would just copy the PNG bands from the band cache
+	void ChangeEveryRow(std::vector<uint8_t>& pixels, const int width, const int height)
+	{
+		const size_t row_size = static_cast<size_t>(width) * 4;
+		for (int y = 0; y < height; y++) pixels.at(static_cast<size_t>(y) * row_size)++;
+	}
+
+	void BenchPngExport(const size_t max_threads)
+	{
+		std::cout << std::format("PNG export {}x{}\n", EXPORT_WIDTH, EXPORT_HEIGHT);
+		std::cout << "compression  threads        ms   speedup       bytes\n";
+
+		std::vector<uint8_t> pixels = MakeSourcePixels(EXPORT_WIDTH, EXPORT_HEIGHT);
+
+		for (size_t i = 0; i < PngWriter::COMPRESSION_NAMES.size(); i++)
+		{
+			const auto compression = static_cast<PngWriter::Compression>(i);
+
+			double single_thread = 0.0;
+			for (size_t threads = 1; threads <= max_threads; threads++)
+			{
+				ThreadPool::SetThreadLimit(threads);
+				const double milliseconds = TimeMilliseconds([&]
+					{
+						ChangeEveryRow(pixels, EXPORT_WIDTH, EXPORT_HEIGHT);
+
+						std::atomic<float> progress{ 0.0f };
+						const std::atomic<bool> cancelled{ false };
+						PngWriter::Write(EXPORT_PATH, EXPORT_WIDTH, EXPORT_HEIGHT, pixels.data(), progress, cancelled, compression);
+					});
+				if (threads == 1) single_thread = milliseconds;
+
+				std::error_code error;
+				const uintmax_t file_size = std::filesystem::file_size(EXPORT_PATH, error);
+				std::cout << std::format("{:11} {:8} {:9.1f} {:8.2f}x {:11}\n", PngWriter::COMPRESSION_NAMES.at(i), threads, milliseconds, single_thread / milliseconds, error ? 0 : file_size);
+			}
+		}
+
+		ThreadPool::SetThreadLimit(0);
+		std::filesystem::remove(EXPORT_PATH);
+		std::cout << '\n';
+	}
+
+	// Every format with its default settings on all threads. Throughput is in megabytes of RGBA pixels going in, not of file coming out
+	void BenchFormats()
+	{
+		std::cout << std::format("Export formats {}x{}\n", EXPORT_WIDTH, EXPORT_HEIGHT);
+		std::cout << "format        ms      MB/s       bytes\n";
+
+		std::vector<uint8_t> pixels = MakeSourcePixels(EXPORT_WIDTH, EXPORT_HEIGHT);
+		const double megabytes = static_cast<double>(pixels.size()) / 1'000'000.0;
+
+		for (size_t i = 0; i < ImageExport::FORMAT_NAMES.size(); i++)
+		{
+			const ImageExport::Settings settings{ static_cast<ImageExport::Format>(i) };
+			const std::string path = std::string{ EXPORT_STEM } + ImageExport::FORMAT_EXTENSIONS.at(i);
+
+			const double milliseconds = TimeMilliseconds([&]
+				{
+					ChangeEveryRow(pixels, EXPORT_WIDTH, EXPORT_HEIGHT);
+
+					std::atomic<float> progress{ 0.0f };
+					const std::atomic<bool> cancelled{ false };
+					ImageExport::Write(path, EXPORT_WIDTH, EXPORT_HEIGHT, pixels.data(), progress, cancelled, settings);
+				});
+
+			std::error_code error;
+			const uintmax_t file_size = std::filesystem::file_size(path, error);
+			std::cout << std::format("{:6} {:9.1f} {:9.1f} {:11}\n", ImageExport::FORMAT_NAMES.at(i), milliseconds, megabytes / (milliseconds / 1000.0), error ? 0 : file_size);
+
+			std::filesystem::remove(path, error);
+		}
+
+		std::cout << '\n';
+	}
+}
+
+int main()
+{
+	const size_t max_threads = ThreadPool::GetThreadCount();
+	const std::vector<uint8_t> source = MakeSourcePixels(SOURCE_WIDTH, SOURCE_HEIGHT);
+
+	BenchResizeThreads(source, max_threads);
+	BenchResizePresets(source, SOURCE_WIDTH, SOURCE_HEIGHT, RESIZED_WIDTH, RESIZED_HEIGHT);
+
+	const std::vector<uint8_t> small_source = MakeSourcePixels(ENLARGE_SOURCE_SIZE, ENLARGE_SOURCE_SIZE);
+	BenchResizePresets(small_source, ENLARGE_SOURCE_SIZE, ENLARGE_SOURCE_SIZE, ENLARGED_SIZE, ENLARGED_SIZE);
+
+	BenchPngExport(max_threads);
+	BenchFormats();
+	return 0;
+}
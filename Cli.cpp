@@ -0,0 +1,293 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include "Fonts.hpp"
+#include "Image.hpp"
+#include "ImageExport.hpp"
+#include "Json.hpp"
+#include "Layout.hpp"
+#include "Project.hpp"
+
+// Renders saved layouts without a window, for scripts and servers. A job is a JSON object:
+// { "output": "banner.png", "layout": "layout.json", "date": "2025-01-31", "time": "13:30:00", "now": false,
+//   "zones": ["Europe/Amsterdam", "America/New_York"], "layers": { "2": { "text": "Hello" } }, "jpeg_quality": 90, "png_compression": "Fast" }
+// Everything but the output is optional. Date, time and zones go to every date time layer, "layers" can change any setting of a layer by its index
+namespace
+{
+	constexpr const char* USAGE
+	{
+		"Usage: TimezoneBannerCli [layout.json | project.tbp] [options]\n"
+		"  -o, --output PATH     Where to write the banner, the extension picks the format\n"
+		"  --date YYYY-MM-DD     Date for every date time layer\n"
+		"  --time HH:MM:SS       Time for every date time layer\n"
+		"  --now                 Use the current date and time instead of the saved ones\n"
+		"  --zones A,B,...       Time zones for every date time layer\n"
+		"  --text INDEX=TEXT     Replaces the text (or format) of the layer at INDEX\n"
+		"  --job FILE            Runs the job in FILE, or every job when it holds an array of them\n"
+		"  --stdin               Runs one job per line from stdin until it closes\n"
+		"Options given together with --job or --stdin are used for whatever the jobs leave out\n"
+	};
+
+	// Parsed layouts by path, so jobs switching between a few layouts don't read them again every time
+	std::map<std::string, Json::Value, std::less<>> layouts;
+
+	// Holds on to the fonts of projects, so the glyphs they came with stay cached for every job using them
+	std::vector<std::shared_ptr<Fonts::Font>> project_fonts;
+
+	// Reused for every job, banners are usually all the same size
+	ImageCache::Pixels pixels;
+
+	// Decoding happens on worker threads, the results still have to be picked up from this one
+	void WaitForLoading()
+	{
+		while (true)
+		{
+			Image::canvas->image.UpdateTextures();
+			bool loading = Image::canvas->image.IsLoading();
+
+			for (const auto& image : Image::images)
+			{
+				image->UpdateTextures();
+				loading |= image->IsLoading();
+			}
+
+			if (!loading) return;
+			std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+		}
+	}
+
+	const Json::Value* GetLayout(const std::string& path)
+	{
+		if (const auto found = layouts.find(path); found != layouts.end()) return &found->second;
+
+		std::optional<Json::Value> layout = path.ends_with(Project::EXTENSION) ? Project::ReadLayout(path, project_fonts) : Json::ReadFile(path);
+		if (!layout) return nullptr;
+
+		return &layouts.emplace(path, std::move(*layout)).first->second;
+	}
+
+	Json::Value ApplyOverrides(Json::Value layout, const Json::Value& job)
+	{
+		Json::Value* layers_value = layout.Find("layers");
+		Json::Array* layers = layers_value != nullptr ? layers_value->GetMutableArray() : nullptr;
+		if (layers == nullptr) return layout;
+
+		for (size_t i = 0; i < layers->size(); i++)
+		{
+			Json::Value& layer = layers->at(i);
+
+			if (layer["type"].GetString() == "date_time")
+			{
+				// The layout falls back to the current time without them
+				if (job["now"].GetBool())
+				{
+					layer.Erase("date");
+					layer.Erase("time");
+				}
+
+				for (const char* key : { "date", "time", "zones" })
+				{
+					if (job.Has(key)) layer.Set(key, job[key]);
+				}
+
+				// A time given in the job wins over a live clock
+				if (job.Has("date") || job.Has("time")) layer.Set("live", false);
+			}
+
+			for (const auto& [key, value] : job["layers"][std::to_string(i)].GetObject()) layer.Set(key, value);
+		}
+
+		return layout;
+	}
+
+	ImageExport::Settings GetExportSettings(const Json::Value& job, const std::string& output)
+	{
+		ImageExport::Settings settings;
+		settings.format = ImageExport::GetFormat(output, ImageExport::Format::Png);
+		settings.jpeg_quality = job["jpeg_quality"].GetInt(settings.jpeg_quality);
+		settings.tga_rle = job["tga_rle"].GetBool(settings.tga_rle);
+
+		const std::string& compression = job["png_compression"].GetString();
+		const auto found = std::ranges::find(PngWriter::COMPRESSION_NAMES, compression);
+		if (found != PngWriter::COMPRESSION_NAMES.end()) settings.png_compression = static_cast<PngWriter::Compression>(found - PngWriter::COMPRESSION_NAMES.begin());
+
+		return settings;
+	}
+
+	// A layer that didn't load would just be left out of the banner, for a script that's worse than not getting one at all
+	bool CheckLayersLoaded(const Json::Value& layout)
+	{
+		if (Image::canvas->image.GetPixels() == nullptr)
+		{
+			std::cout << "Failed to load canvas image" << '\n';
+			return false;
+		}
+
+		const size_t layer_count = layout["layers"].GetArray().size();
+		if (Image::images.size() != layer_count)
+		{
+			std::cout << "Failed to load " << layer_count - std::min<size_t>(Image::images.size(), layer_count) << " of " << layer_count << " layers" << '\n';
+			return false;
+		}
+
+		for (size_t i = 0; i < Image::images.size(); i++)
+		{
+			if (!Image::images.at(i)->IsPlaceholder()) continue;
+
+			std::cout << "Failed to load image of layer " << i << ": " << Image::images.at(i)->GetFilePath() << '\n';
+			return false;
+		}
+
+		return true;
+	}
+
+	bool RunJob(const Json::Value& job)
+	{
+		const std::string& output = job["output"].GetString();
+		if (output.empty())
+		{
+			std::cout << "Job has no output path" << '\n';
+			return false;
+		}
+
+		const Json::Value* layout = GetLayout(job["layout"].GetString());
+		if (layout == nullptr) return false;
+
+		const Json::Value job_layout = ApplyOverrides(*layout, job);
+		if (!Layout::Apply(job_layout)) return false;
+
+		WaitForLoading();
+		if (!CheckLayersLoaded(job_layout)) return false;
+
+		if (!Image::canvas->CompositeOnCpu(pixels))
+		{
+			std::cout << "Failed to composite banner" << '\n';
+			return false;
+		}
+
+		std::atomic<float> progress{ 0.0f };
+		const std::atomic<bool> cancelled{ false };
+		return ImageExport::Write(output, pixels.width, pixels.height, pixels.data.data(), progress, cancelled, GetExportSettings(job, output));
+	}
+
+	// Prints a line per job, so whatever feeds the jobs in can tell which ones failed
+	bool RunAndReport(const Json::Value& job)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const bool succeeded = RunJob(job);
+		const auto duration = std::chrono::duration<double, std::milli>{ std::chrono::steady_clock::now() - start };
+
+		Json::Value result;
+		result.Set("output", job["output"]);
+		result.Set("succeeded", succeeded);
+		result.Set("milliseconds", duration.count());
+		std::cout << Json::Write(result, false) << '\n' << std::flush;
+
+		return succeeded;
+	}
+
+	// Keys in the job replace the defaults
+	Json::Value MergeJob(Json::Value defaults, const Json::Value& job)
+	{
+		for (const auto& [key, value] : job.GetObject()) defaults.Set(key, value);
+		return defaults;
+	}
+
+	bool ParseArguments(const int argc, char* argv[], Json::Value& job, std::string& job_file, bool& read_stdin)
+	{
+		Json::Value layers;
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string argument = argv[i];
+			const bool has_value = i + 1 < argc;
+
+			if (argument == "--stdin") read_stdin = true;
+			else if (argument == "--now") job.Set("now", true);
+			else if ((argument == "-o" || argument == "--output") && has_value) job.Set("output", argv[++i]);
+			else if (argument == "--date" && has_value) job.Set("date", argv[++i]);
+			else if (argument == "--time" && has_value) job.Set("time", argv[++i]);
+			else if (argument == "--job" && has_value) job_file = argv[++i];
+			else if (argument == "--zones" && has_value)
+			{
+				Json::Array zones;
+				const std::string list = argv[++i];
+				for (size_t start = 0; start <= list.size();)
+				{
+					const size_t end = std::min(list.find(',', start), list.size());
+					if (end > start) zones.emplace_back(list.substr(start, end - start));
+					start = end + 1;
+				}
+				job.Set("zones", std::move(zones));
+			}
+			else if (argument == "--text" && has_value)
+			{
+				const std::string assignment = argv[++i];
+				const size_t equals = assignment.find('=');
+				if (equals == std::string::npos) return false;
+
+				Json::Value layer = layers[assignment.substr(0, equals)];
+				layer.Set("text", assignment.substr(equals + 1));
+				layers.Set(assignment.substr(0, equals), std::move(layer));
+			}
+			else if (!argument.starts_with('-') && !job.Has("layout")) job.Set("layout", argument);
+			else return false;
+		}
+
+		if (layers.IsObject()) job.Set("layers", std::move(layers));
+		return true;
+	}
+}
+
+int main(const int argc, char* argv[])
+{
+	Json::Value arguments_job;
+	std::string job_file;
+	bool read_stdin = false;
+	if (!ParseArguments(argc, argv, arguments_job, job_file, read_stdin) || argc < 2)
+	{
+		std::cout << USAGE;
+		return 1;
+	}
+
+	Fonts::SetupDefaultFont();
+
+	size_t failed_count = 0;
+	if (!job_file.empty())
+	{
+		const std::optional<Json::Value> jobs = Json::ReadFile(job_file);
+		if (!jobs) failed_count++;
+		else if (jobs->IsArray())
+		{
+			for (const Json::Value& job : jobs->GetArray()) failed_count += RunAndReport(MergeJob(arguments_job, job)) ? 0 : 1;
+		}
+		else failed_count += RunAndReport(MergeJob(arguments_job, *jobs)) ? 0 : 1;
+	}
+
+	if (read_stdin)
+	{
+		// Everything stays loaded between lines, so only the first banner pays for reading the layout, images and fonts
+		std::ios::sync_with_stdio(false);
+
+		std::string line;
+		while (std::getline(std::cin, line))
+		{
+			if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+			const std::optional<Json::Value> job = Json::Parse(line);
+			failed_count += job && RunAndReport(MergeJob(arguments_job, *job)) ? 0 : 1;
+		}
+	}
+
+	if (job_file.empty() && !read_stdin) failed_count += RunAndReport(arguments_job) ? 0 : 1;
+
+	Image::images.clear();
+	Image::canvas.reset();
+
+	return failed_count == 0 ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+#include "Compositor.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <SDL3/SDL_intrin.h>
+
+#include "ImageResize.hpp"
+#include "ThreadPool.hpp"
+
+namespace Compositor
+{
+	namespace
+	{
+		// Small enough that there are plenty of bands to spread around, big enough that a band is worth scheduling
+		constexpr int BAND_HEIGHT{ 64 };
+
+		struct PreparedLayer
+		{
+			const uint8_t* pixels{ nullptr };
+			int stride{ 0 };
+			SDL_Rect rect{};
+
+			// The part of rect that is on the canvas
+			SDL_Rect visible{};
+			uint32_t color{ 0xFFFFFFFF };
+		};
+
+		// x / 255 rounded to the nearest, exact for every x up to 255 * 255
+		constexpr uint32_t Div255(const uint32_t x)
+		{
+			return (x + 128 + ((x + 128) >> 8)) >> 8;
+		}
+
+		void BlendRowScalar(const uint8_t* source, uint8_t* destination, const size_t pixel_count, const uint32_t color)
+		{
+			const uint32_t mod[4]{ color & 0xFF, (color >> 8) & 0xFF, (color >> 16) & 0xFF, (color >> 24) & 0xFF };
+
+			for (size_t i = 0; i < pixel_count; i++, source += 4, destination += 4)
+			{
+				const uint32_t alpha = Div255(source[3] * mod[3]);
+				const uint32_t inverse = 255 - alpha;
+
+				for (int channel = 0; channel < 3; channel++)
+				{
+					const uint32_t value = Div255(source[channel] * mod[channel]);
+					destination[channel] = static_cast<uint8_t>(Div255(value * alpha + destination[channel] * inverse));
+				}
+				destination[3] = static_cast<uint8_t>(Div255(alpha * 255 + destination[3] * inverse));
+			}
+		}
+
+		void BlendRow(const uint8_t* source, uint8_t* destination, const size_t pixel_count, const uint32_t color)
+		{
+			size_t i = 0;
+
+#ifdef SDL_SSE2_INTRINSICS
+			// Two pixels per 16 bit half, every product stays below 255 * 255 so nothing overflows
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i rounding = _mm_set1_epi16(128);
+			const __m128i full = _mm_set1_epi16(255);
+			const __m128i alpha_lanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+			const __m128i alpha_bytes = _mm_set1_epi32(static_cast<int>(0xFF000000));
+			const __m128i mod = _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(color)), zero);
+			const bool opaque_white = color == 0xFFFFFFFF;
+
+			const auto div255 = [&rounding](const __m128i x)
+				{
+					const __m128i rounded = _mm_add_epi16(x, rounding);
+					return _mm_srli_epi16(_mm_add_epi16(rounded, _mm_srli_epi16(rounded, 8)), 8);
+				};
+
+			const auto blend = [&](__m128i source_half, const __m128i destination_half)
+				{
+					source_half = div255(_mm_mullo_epi16(source_half, mod));
+
+					const __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(source_half, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+					const __m128i inverse = _mm_sub_epi16(full, alpha);
+
+					// The alpha channel gets alpha * 255 instead of alpha * alpha
+					const __m128i factor = _mm_or_si128(_mm_andnot_si128(alpha_lanes, alpha), _mm_and_si128(alpha_lanes, full));
+					return div255(_mm_add_epi16(_mm_mullo_epi16(source_half, factor), _mm_mullo_epi16(destination_half, inverse)));
+				};
+
+			for (; i + 4 <= pixel_count; i += 4)
+			{
+				const __m128i source_pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 4 * i));
+
+				// Most pixels of most layers are fully opaque, those just replace what's below
+				if (opaque_white && _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(source_pixels, alpha_bytes), alpha_bytes)) == 0xFFFF)
+				{
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + 4 * i), source_pixels);
+					continue;
+				}
+
+				const __m128i destination_pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(destination + 4 * i));
+				const __m128i low = blend(_mm_unpacklo_epi8(source_pixels, zero), _mm_unpacklo_epi8(destination_pixels, zero));
+				const __m128i high = blend(_mm_unpackhi_epi8(source_pixels, zero), _mm_unpackhi_epi8(destination_pixels, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + 4 * i), _mm_packus_epi16(low, high));
+			}
+#endif
+
+			BlendRowScalar(source + 4 * i, destination + 4 * i, pixel_count - i, color);
+		}
+	}
+
+	bool Composite(const std::vector<Layer>& layers, const int width, const int height, uint8_t* output)
+	{
+		if (width <= 0 || height <= 0 || output == nullptr) return false;
+
+		const SDL_Rect canvas_rect{ 0, 0, width, height };
+
+		// Resized pixels have to live until every band is done with them
+		std::vector<std::vector<uint8_t>> resized_pixels;
+		std::vector<PreparedLayer> prepared_layers;
+		prepared_layers.reserve(layers.size());
+
+		for (const Layer& layer : layers)
+		{
+			PreparedLayer prepared{ nullptr, layer.rect.w * 4, layer.rect, {}, layer.color };
+			if (layer.pixels == nullptr || (layer.color >> 24) == 0 || !SDL_GetRectIntersection(&layer.rect, &canvas_rect, &prepared.visible)) continue;
+
+			if (layer.rect.w == layer.pixels->width && layer.rect.h == layer.pixels->height)
+			{
+				prepared.pixels = layer.pixels->data.data();
+			}
+			else
+			{
+				// Bilinear when enlarging like the GPU, shrinking isn't quite the same since the GPU picks a mip level instead
+				std::vector<uint8_t>& resized = resized_pixels.emplace_back(4 * static_cast<size_t>(layer.rect.w) * static_cast<size_t>(layer.rect.h));
+				if (!ImageResize::Resize(layer.pixels->data.data(), layer.pixels->width, layer.pixels->height, resized.data(), layer.rect.w, layer.rect.h, { ImageResize::Quality::Balanced }))
+				{
+					std::cout << "Failed to resize layer for compositing" << '\n';
+					return false;
+				}
+				prepared.pixels = resized.data();
+			}
+
+			prepared_layers.push_back(prepared);
+		}
+
+		const size_t row_bytes = 4 * static_cast<size_t>(width);
+		const size_t band_count = static_cast<size_t>((height + BAND_HEIGHT - 1) / BAND_HEIGHT);
+
+		// Bands never share rows, so each one can go through all layers on its own
+		ThreadPool::ParallelFor(band_count, [&](const size_t band)
+			{
+				const int band_top = static_cast<int>(band) * BAND_HEIGHT;
+				const int band_bottom = std::min(band_top + BAND_HEIGHT, height);
+
+				std::memset(output + static_cast<size_t>(band_top) * row_bytes, 0, static_cast<size_t>(band_bottom - band_top) * row_bytes);
+
+				for (const PreparedLayer& layer : prepared_layers)
+				{
+					const int top = std::max(band_top, layer.visible.y);
+					const int bottom = std::min(band_bottom, layer.visible.y + layer.visible.h);
+
+					for (int y = top; y < bottom; y++)
+					{
+						const uint8_t* source = layer.pixels + static_cast<size_t>(y - layer.rect.y) * static_cast<size_t>(layer.stride) + 4 * static_cast<size_t>(layer.visible.x - layer.rect.x);
+						uint8_t* destination = output + static_cast<size_t>(y) * row_bytes + 4 * static_cast<size_t>(layer.visible.x);
+						BlendRow(source, destination, static_cast<size_t>(layer.visible.w), layer.color);
+					}
+				}
+			});
+
+		return true;
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <SDL3/SDL_rect.h>
+
+#include "ImageCache.hpp"
+
+// Blends layers into memory without touching the GPU, so banners can be made on machines without a display
+namespace Compositor
+{
+	struct Layer
+	{
+		// Layers that are still loading don't have any yet and get skipped
+		std::shared_ptr<const ImageCache::Pixels> pixels;
+
+		// Where the layer ends up on the canvas, layers that don't match their pixel size get resized first
+		SDL_Rect rect{};
+
+		// Same layout as Image::GetColor, multiplied with the pixels like the texture color and alpha mod
+		uint32_t color{ 0xFFFFFFFF };
+	};
+
+	// Blends the layers in order on top of a transparent width x height RGBA buffer, the same way SDL_BLENDMODE_BLEND does.
+	// Output has to fit 4 * width * height bytes. The rows are split into bands that run on the thread pool.
+	// Unscaled layers come out within 2 of the GPU per channel, both only round differently. Scaled layers differ more, the GPU filters them bilinearly
+	bool Composite(const std::vector<Layer>& layers, int width, int height, uint8_t* output);
+}
@@ -0,0 +1,199 @@
+#include "ExportQueue.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include "ImageResize.hpp"
+#include "Renderer.hpp"
+
+namespace ExportQueue
+{
+	namespace
+	{
+		struct QueuedJob
+		{
+			std::shared_ptr<Job> job;
+			Renderer::Readback readback;
+		};
+
+		void RunJob(Job& job, Renderer::Readback readback)
+		{
+			if (job.cancelled)
+			{
+				job.state = State::Cancelled;
+				return;
+			}
+
+			job.state = State::Encoding;
+
+			int width = readback.GetWidth();
+			int height = readback.GetHeight();
+			const uint8_t* pixels = readback.GetData();
+
+			std::vector<uint8_t> scaled_pixels;
+			if (job.scale != 1.0f)
+			{
+				// Using std::max because you just know someone is going to try to make an image that is 0 x 0
+				const int scaled_width = std::max<int>(static_cast<int>(job.scale * static_cast<float>(width)), 1);
+				const int scaled_height = std::max<int>(static_cast<int>(job.scale * static_cast<float>(height)), 1);
+
+				scaled_pixels.resize(4 * static_cast<size_t>(scaled_width) * static_cast<size_t>(scaled_height));
+				if (!ImageResize::Resize(pixels, width, height, scaled_pixels.data(), scaled_width, scaled_height))
+				{
+					std::cout << "Failed to resize export" << '\n';
+					job.state = State::Failed;
+					return;
+				}
+
+				width = scaled_width;
+				height = scaled_height;
+				pixels = scaled_pixels.data();
+
+				// The full size pixels aren't needed anymore, no reason to keep them around while encoding
+				readback = {};
+			}
+
+			const bool succeeded = ImageExport::Write(job.path, width, height, pixels, job.progress, job.cancelled, job.settings);
+			job.state = job.cancelled ? State::Cancelled : succeeded ? State::Finished : State::Failed;
+		}
+
+		class Queue
+		{
+		public:
+			Queue()
+			{
+				for (size_t i = 0; i < MAX_RUNNING_JOBS; i++)
+				{
+					workers.emplace_back([this](const std::stop_token& stop_token) { WorkerLoop(stop_token); });
+				}
+			}
+
+			~Queue()
+			{
+				{
+					std::lock_guard lock{ mutex };
+					for (auto& worker : workers) worker.request_stop();
+				}
+				condition.notify_all();
+			}
+
+			void Add(std::shared_ptr<Job> job)
+			{
+				std::lock_guard lock{ mutex };
+				jobs.push_back(std::move(job));
+			}
+
+			void Enqueue(std::shared_ptr<Job> job, Renderer::Readback readback)
+			{
+				{
+					std::lock_guard lock{ mutex };
+					job->state = State::Queued;
+					queued_jobs.push_back({ std::move(job), std::move(readback) });
+				}
+				condition.notify_one();
+			}
+
+			[[nodiscard]] std::vector<std::shared_ptr<Job>> GetJobs()
+			{
+				std::lock_guard lock{ mutex };
+				return jobs;
+			}
+
+			void ClearFinishedJobs()
+			{
+				std::lock_guard lock{ mutex };
+				std::erase_if(jobs, [](const std::shared_ptr<Job>& job) { return job->IsDone(); });
+			}
+
+			void WaitForAll()
+			{
+				std::unique_lock lock{ mutex };
+				idle_condition.wait(lock, [this] { return queued_jobs.empty() && running_count == 0; });
+			}
+
+		private:
+			void WorkerLoop(const std::stop_token& stop_token)
+			{
+				while (true)
+				{
+					QueuedJob queued_job;
+					{
+						std::unique_lock lock{ mutex };
+						condition.wait(lock, [this, &stop_token] { return !queued_jobs.empty() || stop_token.stop_requested(); });
+						if (stop_token.stop_requested()) return;
+
+						queued_job = std::move(queued_jobs.front());
+						queued_jobs.pop_front();
+						running_count++;
+					}
+
+					RunJob(*queued_job.job, std::move(queued_job.readback));
+
+					{
+						std::lock_guard lock{ mutex };
+						running_count--;
+					}
+					idle_condition.notify_all();
+
+					// Shows the finished state right away instead of on the next progress refresh
+					Renderer::RequestRedraw();
+				}
+			}
+
+			std::mutex mutex;
+			std::condition_variable condition;
+			std::condition_variable idle_condition;
+
+			std::vector<std::shared_ptr<Job>> jobs;
+			std::deque<QueuedJob> queued_jobs;
+			size_t running_count{ 0 };
+
+			// Declared last so the threads are joined before the rest gets destroyed
+			std::vector<std::jthread> workers;
+		};
+
+		Queue& GetQueue()
+		{
+			static Queue queue;
+			return queue;
+		}
+	}
+
+	std::shared_ptr<Job> CreateJob(std::string path, const ImageExport::Settings& settings, const float scale)
+	{
+		auto job = std::make_shared<Job>(std::move(path), settings, scale);
+		GetQueue().Add(job);
+
+		return job;
+	}
+
+	void Enqueue(const std::shared_ptr<Job>& job, Renderer::Readback readback)
+	{
+		if (!readback.IsValid())
+		{
+			job->state = job->cancelled ? State::Cancelled : State::Failed;
+			return;
+		}
+
+		GetQueue().Enqueue(job, std::move(readback));
+	}
+
+	std::vector<std::shared_ptr<Job>> GetJobs()
+	{
+		return GetQueue().GetJobs();
+	}
+
+	void ClearFinishedJobs()
+	{
+		GetQueue().ClearFinishedJobs();
+	}
+
+	void WaitForAll()
+	{
+		GetQueue().WaitForAll();
+	}
+}
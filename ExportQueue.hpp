@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ImageExport.hpp"
+#include "TiledTexture.hpp"
+
+namespace ExportQueue
+{
+	// Only this many exports encode at the same time, the rest wait in line. They split their own work over the thread pool too
+	constexpr size_t MAX_RUNNING_JOBS{ 2 };
+
+	enum class State : uint8_t
+	{
+		ReadingBack,	// Waiting for the canvas pixels to come back from the GPU
+		Queued,
+		Encoding,
+		Finished,
+		Failed,
+		Cancelled,
+	};
+
+	constexpr std::array<const char*, 6> STATE_NAMES{ "Reading back", "Queued", "Encoding", "Finished", "Failed", "Cancelled" };
+
+	struct Job
+	{
+		Job(std::string path, const ImageExport::Settings& settings, float scale) : path{ std::move(path) }, settings{ settings }, scale{ scale } {}
+
+		[[nodiscard]] bool IsDone() const { return state >= State::Finished; }
+
+		const std::string path;
+		const ImageExport::Settings settings;
+
+		// The canvas gets resized by this before encoding, so one banner can be exported at several resolutions
+		const float scale;
+
+		// Written by the worker, read by the UI
+		std::atomic<State> state{ State::ReadingBack };
+		std::atomic<float> progress{ 0.0f };
+
+		// Set from the UI, the worker stops as soon as the format allows it
+		std::atomic<bool> cancelled{ false };
+	};
+
+	// Adds the job to the list, it still needs its pixels from Enqueue before anything happens
+	std::shared_ptr<Job> CreateJob(std::string path, const ImageExport::Settings& settings, float scale);
+
+	// Hands the read back pixels to the job, encoding starts once fewer than MAX_RUNNING_JOBS are running.
+	// An invalid readback marks the job as failed
+	void Enqueue(const std::shared_ptr<Job>& job, Renderer::Readback readback);
+
+	// Every job that was created and not cleared yet, oldest first
+	[[nodiscard]] std::vector<std::shared_ptr<Job>> GetJobs();
+	void ClearFinishedJobs();
+
+	// Blocks until every queued and running job is done, the workers are detached from the UI so this has to happen before quitting
+	void WaitForAll();
+}
@@ -1,5 +1,6 @@
 #include "Fonts.hpp"
 
+#include <bit>
 #include <filesystem>
 #include <iostream>
 #include <fstream>
@@ -10,12 +11,16 @@
 #include <stb_truetype.h>
 
 #include "ColorUtils.hpp"
+#include "Profiler.hpp"
 
 namespace Fonts
 {
 	namespace
 	{
 		const std::filesystem::path FONTS_LOCATION{ "C:/Windows/Fonts" };
+
+		// Plenty for a few sizes of a few alphabets, the cache starts over once it gets bigger than this
+		constexpr size_t MAX_CACHED_GLYPHS{ 4096 };
 		FontPath default_font_path{ "" };
 
 		std::map<std::filesystem::path, std::weak_ptr<Font>> font_map;
@@ -34,10 +39,14 @@ namespace Fonts
 		path = FontPath{ font_path };
 		data.clear();
 
+		std::error_code error;
+		const std::filesystem::file_time_type modified = std::filesystem::last_write_time(font_path, error);
+		if (!error) file_modified = modified.time_since_epoch().count();
+
 		file.unsetf(std::ios::skipws);
 
 		file.seekg(0, std::ios::end);
-		std::streampos file_size = file.tellg();
+		file_size = static_cast<uintmax_t>(file.tellg());
 		file.seekg(0, std::ios::beg);
 
 		data.reserve(file_size);
@@ -50,15 +59,59 @@ namespace Fonts
 		stbtt_InitFont(&info, data.data(), stbtt_GetFontOffsetForIndex(data.data(), 0));
 	}
 
+	const Font::Glyph& Font::GetGlyph(const int codepoint, const float scale, const int ascent) const
+	{
+		const uint64_t key = static_cast<uint64_t>(static_cast<uint32_t>(codepoint)) << 32 | std::bit_cast<uint32_t>(scale);
+		if (const auto found = glyphs.find(key); found != glyphs.end()) return found->second;
+
+		Glyph& glyph = glyphs[key];
+
+		// how wide is this character
+		int advance_width;
+		int left_side_bearing;
+		stbtt_GetCodepointHMetrics(&info, codepoint, &advance_width, &left_side_bearing);
+		left_side_bearing = static_cast<int>(floorf(static_cast<float>(left_side_bearing) * scale));
+		glyph.advance = static_cast<int>(floorf(static_cast<float>(advance_width) * scale));
+
+		int x1, y1, x2, y2;
+		stbtt_GetCodepointBitmapBox(&info, codepoint, scale, scale, &x1, &y1, &x2, &y2);
+		glyph.bounds = { left_side_bearing, y1 + ascent, x2 - x1, y2 - y1 };
+
+		glyph.bitmap.resize(static_cast<size_t>(glyph.bounds.w * glyph.bounds.h), 0);
+		stbtt_MakeCodepointBitmap(&info, glyph.bitmap.data(), glyph.bounds.w, glyph.bounds.h, glyph.bounds.w, scale, scale, codepoint);
+		Profiler::Count(Profiler::Counter::GlyphsRasterized);
+
+		return glyph;
+	}
+
+	void Font::VisitCachedGlyphs(const std::function<void(int codepoint, float scale, const Glyph& glyph)>& visitor) const
+	{
+		std::lock_guard lock{ glyph_mutex };
+		for (const auto& [key, glyph] : glyphs) visitor(static_cast<int>(key >> 32), std::bit_cast<float>(static_cast<uint32_t>(key)), glyph);
+	}
+
+	void Font::AddCachedGlyph(const int codepoint, const float scale, Glyph glyph) const
+	{
+		const uint64_t key = static_cast<uint64_t>(static_cast<uint32_t>(codepoint)) << 32 | std::bit_cast<uint32_t>(scale);
+
+		std::lock_guard lock{ glyph_mutex };
+		if (glyphs.size() < MAX_CACHED_GLYPHS) glyphs.try_emplace(key, std::move(glyph));
+	}
+
 	// Based on stb true type examples: https://github.com/justinmeiners/stb-truetype-example/blob/master/main.c
 	std::vector<uint8_t> Font::CreateTextBitmap(const std::string& text, const float line_height, int& out_width, int& out_height) const
 	{
 		struct CharacterBitmap
 		{
-			std::vector<uint8_t> data;
+			const std::vector<uint8_t>* data;
 			SDL_Rect bounds;
 		};
 
+		std::lock_guard lock{ glyph_mutex };
+
+		// Only cleared in between texts, the glyphs of this one are pointed to until it is done
+		if (glyphs.size() > MAX_CACHED_GLYPHS) glyphs.clear();
+
 		/* calculate font scaling */
 		const float scale = stbtt_ScaleForPixelHeight(&info, line_height);
 
@@ -94,23 +147,10 @@ namespace Fonts
 				continue;
 			}
 
-			// how wide is this character
-			int advance_width;
-			int left_side_bearing;
-			stbtt_GetCodepointHMetrics(&info, character, &advance_width, &left_side_bearing);
-			left_side_bearing = static_cast<int>(floorf(static_cast<float>(left_side_bearing) * scale));
-
-			// (Note that each Codepoint call has an alternative Glyph version which caches the work required to look up the character word[i].)
-
-			int x1, y1, x2, y2;
-			stbtt_GetCodepointBitmapBox(&info, character, scale, scale, &x1, &y1, &x2, &y2);
-
-			SDL_Rect bounds{ x + left_side_bearing, y + y1 + ascent, x2 - x1, y2 - y1 };
-
-			std::vector<uint8_t> bitmap_data(static_cast<size_t>(bounds.w * bounds.h), 0);
-			stbtt_MakeCodepointBitmap(&info, bitmap_data.data(), bounds.w, bounds.h, bounds.w, scale, scale, character);
+			const Glyph& glyph = GetGlyph(character, scale, ascent);
+			const SDL_Rect bounds{ x + glyph.bounds.x, y + glyph.bounds.y, glyph.bounds.w, glyph.bounds.h };
 
-			character_infos.emplace_back(std::move(bitmap_data), bounds);
+			character_infos.push_back({ &glyph.bitmap, bounds });
 
 			min_x = std::min<int>(min_x, bounds.x);
 			min_y = std::min<int>(min_y, bounds.y);
@@ -118,7 +158,7 @@ namespace Fonts
 			max_x = std::max<int>(max_x, bounds.x + bounds.w);
 			max_y = std::max<int>(max_y, y + scaled_line_height);
 
-			x += static_cast<int>(floorf(static_cast<float>(advance_width) * scale));
+			x += glyph.advance;
 
 			// add kerning
 			if (i < text.size() - 1 && text[i + 1] != '\n')
@@ -140,7 +180,7 @@ namespace Fonts
 				const int64_t character_index = x_pos + y_pos * character_bounds.w;
 
 				uint8_t& bitmap_value = bitmap_data.at(bitmap_index);
-				bitmap_value = AddColorComponent(bitmap_value, character_data.at(character_index));
+				bitmap_value = AddColorComponent(bitmap_value, character_data->at(character_index));
 			}
 		}
 
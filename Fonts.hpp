@@ -1,6 +1,10 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 #include <stb_truetype.h> // Don't define implementation, should only be defined in Fonts.cpp
@@ -27,13 +31,36 @@ namespace Fonts
 	public:
 		explicit Font(const std::filesystem::path& font_path);
 
+		// Rasterized once per size, banners mostly redraw the same few characters over and over
+		struct Glyph
+		{
+			std::vector<uint8_t> bitmap;
+			SDL_Rect bounds{};	// Relative to the pen position on the top of the line
+			int advance{ 0 };
+		};
+
 		std::vector<uint8_t> CreateTextBitmap(const std::string& text, float line_height, int& out_width, int& out_height) const;
 		[[nodiscard]] const FontPath& GetPath() const { return path; }
 
+		// Of the file as it was when it got loaded, projects use them to tell whether their saved glyphs still belong to it
+		[[nodiscard]] int64_t GetFileModified() const { return file_modified; }
+		[[nodiscard]] uintmax_t GetFileSize() const { return file_size; }
+
+		// For saving the cache with a project, so opening it again doesn't have to rasterize everything. Scale is the stb_truetype scale, not the line height
+		void VisitCachedGlyphs(const std::function<void(int codepoint, float scale, const Glyph& glyph)>& visitor) const;
+		void AddCachedGlyph(int codepoint, float scale, Glyph glyph) const;
+
 	private:
+		const Glyph& GetGlyph(int codepoint, float scale, int ascent) const;
+
 		FontPath path;
+		int64_t file_modified{ 0 };
+		uintmax_t file_size{ 0 };
 		std::vector<uint8_t> data;
 		stbtt_fontinfo info{};
+
+		mutable std::mutex glyph_mutex;
+		mutable std::unordered_map<uint64_t, Glyph> glyphs;
 	};
 
 	void SetupDefaultFont();
@@ -0,0 +1,215 @@
+#include "History.hpp"
+
+#include <deque>
+#include <map>
+#include <optional>
+#include <vector>
+
+#include "Image.hpp"
+#include "Json.hpp"
+#include "Layout.hpp"
+
+namespace History
+{
+	namespace
+	{
+		// A step is usually a few hundred bytes, so this is plenty without ever adding up to much
+		constexpr size_t MAX_STEPS{ 512 };
+
+		struct LayerChange
+		{
+			uint64_t id{ 0 };
+			Json::Value before;	// Null when the layer was added
+			Json::Value after;	// Null when the layer was removed
+		};
+
+		struct Step
+		{
+			// Only set when the canvas changed
+			std::optional<Json::Value> canvas_before;
+			std::optional<Json::Value> canvas_after;
+
+			// Only set when layers were added, removed or moved
+			std::optional<std::vector<uint64_t>> order_before;
+			std::optional<std::vector<uint64_t>> order_after;
+
+			std::vector<LayerChange> layers;
+		};
+
+		std::deque<Step> undo_steps;
+		std::vector<Step> redo_steps;
+
+		// What the layout looked like after the last step, changes are found by comparing against it
+		std::optional<Json::Value> recorded;
+		bool pending{ false };
+
+		std::vector<uint64_t> GetOrder(const Json::Value& layout)
+		{
+			std::vector<uint64_t> order;
+			for (const Json::Value& layer : layout["layers"].GetArray()) order.push_back(Layout::GetLayerId(layer));
+
+			return order;
+		}
+
+		std::map<uint64_t, const Json::Value*> GetLayersById(const Json::Value& layout)
+		{
+			std::map<uint64_t, const Json::Value*> layers;
+			for (const Json::Value& layer : layout["layers"].GetArray()) layers.emplace(Layout::GetLayerId(layer), &layer);
+
+			return layers;
+		}
+
+		std::optional<Step> Diff(const Json::Value& before, const Json::Value& after)
+		{
+			Step step;
+			if (before["canvas"] != after["canvas"])
+			{
+				step.canvas_before = before["canvas"];
+				step.canvas_after = after["canvas"];
+			}
+
+			std::vector<uint64_t> order_before = GetOrder(before);
+			std::vector<uint64_t> order_after = GetOrder(after);
+			if (order_before != order_after)
+			{
+				step.order_before = std::move(order_before);
+				step.order_after = std::move(order_after);
+			}
+
+			const std::map<uint64_t, const Json::Value*> layers_before = GetLayersById(before);
+			const std::map<uint64_t, const Json::Value*> layers_after = GetLayersById(after);
+
+			for (const auto& [id, layer] : layers_after)
+			{
+				const auto found = layers_before.find(id);
+				if (found == layers_before.end()) step.layers.push_back({ id, {}, *layer });
+				else if (*found->second != *layer) step.layers.push_back({ id, *found->second, *layer });
+			}
+
+			for (const auto& [id, layer] : layers_before)
+			{
+				if (!layers_after.contains(id)) step.layers.push_back({ id, *layer, {} });
+			}
+
+			if (!step.canvas_before && !step.order_before && step.layers.empty()) return std::nullopt;
+			return step;
+		}
+
+		// Rebuilds the layout on the other side of the step
+		Json::Value Replay(const Json::Value& layout, const Step& step, const bool backwards)
+		{
+			std::map<uint64_t, Json::Value> layers;
+			for (const Json::Value& layer : layout["layers"].GetArray()) layers.emplace(Layout::GetLayerId(layer), layer);
+
+			for (const LayerChange& change : step.layers)
+			{
+				const Json::Value& target = backwards ? change.before : change.after;
+				if (target.IsNull()) layers.erase(change.id);
+				else layers.insert_or_assign(change.id, target);
+			}
+
+			Json::Value result = layout;
+			if (step.canvas_before) result.Set("canvas", backwards ? *step.canvas_before : *step.canvas_after);
+
+			const std::optional<std::vector<uint64_t>>& order = backwards ? step.order_before : step.order_after;
+
+			Json::Array ordered_layers;
+			for (const uint64_t id : order ? *order : GetOrder(layout))
+			{
+				if (const auto found = layers.find(id); found != layers.end()) ordered_layers.push_back(std::move(found->second));
+			}
+			result.Set("layers", std::move(ordered_layers));
+
+			return result;
+		}
+
+		// Turns whatever changed since the last step into a new one
+		void Record()
+		{
+			pending = false;
+
+			Json::Value current = Layout::Capture();
+			if (recorded)
+			{
+				if (std::optional<Step> step = Diff(*recorded, current))
+				{
+					undo_steps.push_back(std::move(*step));
+					if (undo_steps.size() > MAX_STEPS) undo_steps.pop_front();
+
+					redo_steps.clear();
+				}
+			}
+
+			recorded = std::move(current);
+		}
+
+		void Restore(const Json::Value& layout)
+		{
+			Layout::Apply(layout);
+
+			// Layers that failed to load are gone now, so this is what the next step gets compared to instead
+			recorded = Layout::Capture();
+		}
+	}
+
+	void Update(const bool editing)
+	{
+		if (Image::canvas == nullptr)
+		{
+			Clear();
+			return;
+		}
+
+		if (editing) pending = true;
+		else if (pending || !recorded) Record();
+	}
+
+	bool Undo()
+	{
+		if (Image::canvas == nullptr) return false;
+
+		// Edits that were still in progress count as a step of their own
+		Record();
+		if (undo_steps.empty()) return false;
+
+		Step step = std::move(undo_steps.back());
+		undo_steps.pop_back();
+
+		Restore(Replay(*recorded, step, true));
+		redo_steps.push_back(std::move(step));
+		return true;
+	}
+
+	bool Redo()
+	{
+		if (Image::canvas == nullptr) return false;
+
+		Record();
+		if (redo_steps.empty()) return false;
+
+		Step step = std::move(redo_steps.back());
+		redo_steps.pop_back();
+
+		Restore(Replay(*recorded, step, false));
+		undo_steps.push_back(std::move(step));
+		return true;
+	}
+
+	bool CanUndo()
+	{
+		return !undo_steps.empty() || pending;
+	}
+
+	bool CanRedo()
+	{
+		return !redo_steps.empty();
+	}
+
+	void Clear()
+	{
+		undo_steps.clear();
+		redo_steps.clear();
+		recorded.reset();
+		pending = false;
+	}
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+// Undo and redo for everything a layout holds: positions, sizes, colors, texts, fonts, zones and the order of the layers.
+// Steps only keep the settings of the layers that changed, never their pixels. Going back applies them like a layout,
+// so only the layers that actually differ get rasterized or loaded again (mostly straight from the image cache)
+namespace History
+{
+	// Call once a frame after the UI. While editing (like in the middle of a drag) nothing gets recorded,
+	// the whole edit becomes one step once it's done
+	void Update(bool editing);
+
+	bool Undo();
+	bool Redo();
+	[[nodiscard]] bool CanUndo();
+	[[nodiscard]] bool CanRedo();
+
+	void Clear();
+}
@@ -4,130 +4,125 @@
 #include <stb_image.h>
 #define STB_IMAGE_RESIZE_IMPLEMENTATION
 #include <stb_image_resize2.h>
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include <stb_image_write.h>
-#include <imgui.h>
-#include <imgui/misc/cpp/imgui_stdlib.h>
-#include <imsearch/imsearch.h>
 #include <SDL3/SDL_render.h>
 
+#include <atomic>
 #include <future>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <thread>
 
 #include "Renderer.hpp"
 #include "ColorUtils.hpp"
+#include "Compositor.hpp"
+#include "ImageCache.hpp"
+#include "ImageResize.hpp"
+#include "MappedFile.hpp"
+#include "Profiler.hpp"
 
 using namespace std::chrono;
 
 namespace Image
 {
-	namespace
+	struct LoadState
 	{
-		template <typename Type>
-		bool ClampValue(Type& value, const Type min, const Type max)
-		{
-			if (value < min)
-			{
-				value = min;
-				return true;
-			}
+		std::atomic<float> progress{ 0.0f };
+		std::atomic<bool> cancelled{ false };
+		std::atomic<bool> finished{ false };
 
-			if (value > max)
-			{
-				value = max;
-				return true;
-			}
+		// What the pixels are cached under, for finding them in the texture cache
+		ImageCache::Key key;
 
-			return false;
-		}
+		// Only touched by the worker until finished is set, after that only by the main thread
+		std::shared_ptr<const ImageCache::Pixels> pixels;
+	};
 
-		template <typename IntType, typename DateType>
-		bool DragDate(const std::string& label, DateType& value, const int min = 0, const int max = 0, const float speed = 0.25f)
-		{
-			int date = static_cast<int>(static_cast<IntType>(value));
+	namespace
+	{
+		constexpr uint32_t PLACEHOLDER_COLOR{ 0x80808080 };
 
-			bool changed = false;
-			if (min != 0 && max != 0) changed |= ClampValue(date, min, max);
+		// Decoding takes the bulk of the time, so finishing it gets most of the progress bar, the rest is for resizing
+		constexpr float DECODE_PROGRESS_SHARE{ 0.9f };
 
-			changed |= ImGui::DragInt(label.c_str(), &date, speed, min, max, "%d", ImGuiSliderFlags_ClampOnInput);
-			if (!changed) return false;
+		// Moving a handful of layers at once stays below this, more than that is usually everything changing anyway
+		constexpr size_t MAX_DIRTY_RECTS{ 8 };
 
-			value = DateType{ static_cast<IntType>(date) };
-			return true;
-		}
+		// Every placeholder is the same single pixel, so they all share one texture
+		const std::string PLACEHOLDER_KEY{ "placeholder" };
 
-		template <typename TimeType>
-		bool DragTime(const std::string& label, TimeType& value, const int min, const int max, const float speed = 0.25f)
+		// Only reads the header, which is all we need to know whether it is worth decoding
+		bool ProbeImage(const File::MappedFile& file, int& width, int& height)
 		{
-			int time = static_cast<int>(std::chrono::duration_cast<TimeType>(value).count());
-
-			bool changed = false;
-			if (min != 0 && max != 0) changed |= ClampValue(time, min, max);
+			if (!file.IsValid()) return false;
 
-			changed |= ImGui::DragInt(label.c_str(), &time, speed, min, max, "%d", ImGuiSliderFlags_ClampOnInput);
-			if (!changed) return false;
+			// stb_image takes the length as an int, bigger files would wrap around to a negative or cut off length
+			if (file.GetSize() > static_cast<size_t>(std::numeric_limits<int>::max()))
+			{
+				std::cout << "Image file is too large to load: " << file.GetSize() << " bytes" << '\n';
+				return false;
+			}
 
-			value = TimeType{ static_cast<unsigned int>(time) };
-			return true;
+			return stbi_info_from_memory(file.GetData(), static_cast<int>(file.GetSize()), &width, &height, nullptr);
 		}
 
-		bool DragDate(const std::string& label, year_month_day& value, const float speed = 0.25f)
+		bool FitsDecodeMemoryLimit(const int width, const int height)
 		{
-			ImGui::Text("%s", label.c_str());
-			const float drag_width = ImGui::GetContentRegionAvail().x / 3.0f;
-
-			bool changed = false;
-			year year = value.year();
-			ImGui::SetNextItemWidth(drag_width);
-			changed |= DragDate<int>("##Year", year, 0, 0, speed);
-			ImGui::SameLine();
-
-			month month = value.month();
-			ImGui::SetNextItemWidth(drag_width);
-			changed |= DragDate<unsigned int>("##Month", month, 1, 12, speed);
-			ImGui::SameLine();
-
-			const unsigned int max_day_count = static_cast<unsigned int>(year_month_day_last{ year / month / last }.day());
-			day day = value.day();
-			ImGui::SetNextItemWidth(drag_width);
-			changed |= DragDate<unsigned int>("##Day", day, 1, static_cast<int>(max_day_count), speed);
-
-			if (!changed) return false;
-
-			value = year / month / day;
-			return true;
+			return static_cast<uint64_t>(width) * static_cast<uint64_t>(height) * 4 <= decode_memory_limit;
 		}
 
-		bool DragTime(const std::string& label, hh_mm_ss<seconds>& value, const float speed = 0.25f)
+		std::shared_ptr<const ImageCache::Pixels> DecodeFile(LoadState& state, const std::string& path)
 		{
-			ImGui::Text("%s", label.c_str());
-			const float drag_width = ImGui::GetContentRegionAvail().x / 3.0f;
-
-			bool changed = false;
-			hours hour = value.hours();
-			ImGui::SetNextItemWidth(drag_width);
-			changed |= DragTime("##Hour", hour, 0, 23, speed);
-			ImGui::SameLine();
+			// Decoding straight from the mapped file skips copying everything through a read buffer first
+			const File::MappedFile file{ path };
 
-			minutes minute = value.minutes();
-			ImGui::SetNextItemWidth(drag_width);
-			changed |= DragTime("##Minute", minute, 0, 59, speed);
-			ImGui::SameLine();
+			// Probing also rejects files too large for stb_image, so the size fits in an int below
+			int width, height;
+			if (!ProbeImage(file, width, height) || !FitsDecodeMemoryLimit(width, height) || state.cancelled) return nullptr;
 
-			seconds second = value.seconds();
-			ImGui::SetNextItemWidth(drag_width);
-			changed |= DragTime("##Second", second, 0, 59, speed);
+			uint8_t* image_data = stbi_load_from_memory(file.GetData(), static_cast<int>(file.GetSize()), &width, &height, nullptr, 4);
+			if (image_data == nullptr || state.cancelled)
+			{
+				stbi_image_free(image_data);
+				return nullptr;
+			}
 
-			if (!changed) return false;
+			ImageCache::Pixels pixels{ width, height };
+			pixels.data.assign(image_data, image_data + static_cast<size_t>(width) * static_cast<size_t>(height) * 4);
+			stbi_image_free(image_data);
 
-			value = hh_mm_ss{ hour + minute + second };
-			return true;
+			return ImageCache::Insert(ImageCache::MakeKey(path), std::move(pixels));
 		}
 
-		// Used asynchronously to show the user a modal dialog while exporting, path and data are non const references because they are moved to this function
-		void AsyncExport(std::string path, const int width, const int height, std::vector<uint32_t> data)
+		// Runs on a detached worker thread, the state is shared so the image can be destroyed (or moved) while this is still running
+		void AsyncLoad(const std::shared_ptr<LoadState> state, const std::string path, const int scaled_width, const int scaled_height, const ImageResize::Settings resize_settings)
 		{
-			stbi_write_png(path.c_str(), width, height, 4, data.data(), 4 * width);
+			// Scaled variants are derived from the cached full resolution pixels, so the file is only read from disk once
+			const ImageCache::Key scaled_key = ImageCache::MakeKey(path, scaled_width, scaled_height, resize_settings);
+			state->pixels = ImageCache::Find(scaled_key);
+			if (state->pixels == nullptr)
+			{
+				std::shared_ptr<const ImageCache::Pixels> source = ImageCache::Find(ImageCache::MakeKey(path));
+				if (source == nullptr) source = DecodeFile(*state, path);
+
+				if (source != nullptr && !state->cancelled)
+				{
+					if (source->width == scaled_width && source->height == scaled_height) state->pixels = std::move(source);
+					else
+					{
+						state->progress = DECODE_PROGRESS_SHARE;
+
+						ImageCache::Pixels scaled{ scaled_width, scaled_height };
+						scaled.data.resize(static_cast<size_t>(scaled_width) * static_cast<size_t>(scaled_height) * 4);
+						if (ImageResize::Resize(source->data.data(), source->width, source->height, scaled.data.data(), scaled_width, scaled_height, resize_settings))
+							state->pixels = ImageCache::Insert(scaled_key, std::move(scaled));
+					}
+				}
+			}
+
+			state->progress = 1.0f;
+			state->finished = true;
+			Renderer::RequestRedraw();
 		}
 	}
 
@@ -135,67 +130,167 @@ namespace Image
 	{
 		if (data == nullptr) return;
 
-		CreateTexture(data);
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		SetTexture(TextureCache::Create(std::make_shared<const ImageCache::Pixels>(width, height, std::vector(bytes, bytes + 4 * static_cast<size_t>(width) * static_cast<size_t>(height)))));
 	}
 
-	Image::Image(const std::filesystem::path& file_path, const float scaling)
+	Image::Image(const std::filesystem::path& file_path, const float scaling, const ImageResize::Settings& resize_settings) :
+		file_path{ file_path.generic_string() }, resize_settings{ resize_settings }
 	{
-		const std::string path = file_path.generic_string();
-
-		uint8_t* image_data = stbi_load(path.c_str(), &width, &height, nullptr, 4);
-		if (image_data == nullptr)
+		// Only the header is read here, so we know the final size right away and can show a placeholder while the worker decodes the rest
+		if (!ProbeImage(File::MappedFile{ file_path }, file_resolution.x, file_resolution.y))
 		{
 			std::cout << "Failed to load image" << '\n';
+			this->file_path.clear();
 			return;
 		}
 
-		if (scaling == 1.0f)
+		// Rejected before anything gets allocated for it, stb_image would otherwise happily try to decode it
+		if (!FitsDecodeMemoryLimit(file_resolution.x, file_resolution.y))
 		{
-			CreateTexture(image_data);
-			stbi_image_free(image_data);
-
+			std::cout << "Image is too large to load: " << file_resolution.x << " x " << file_resolution.y << '\n';
+			this->file_path.clear();
 			return;
 		}
 
-		// Using std::max because you just know someone is going to try to make an image that is 0 x 0
-		const int scaled_width = std::max<int>(static_cast<int>(scaling * static_cast<float>(width)), 1);
-		const int scaled_height = std::max<int>(static_cast<int>(scaling * static_cast<float>(height)), 1);
-		std::vector<uint8_t> data(static_cast<size_t>(scaled_width) * static_cast<size_t>(scaled_height) * 4);
-
-		stbir_resize_uint8_linear(image_data, width, height, width * 4, data.data(), scaled_width, scaled_height, scaled_width * 4, STBIR_RGBA);
-		stbi_image_free(image_data);
+		width = file_resolution.x;
+		height = file_resolution.y;
+		if (scaling != 1.0f)
+		{
+			// Using std::max because you just know someone is going to try to make an image that is 0 x 0
+			width = std::max<int>(static_cast<int>(scaling * static_cast<float>(file_resolution.x)), 1);
+			height = std::max<int>(static_cast<int>(scaling * static_cast<float>(file_resolution.y)), 1);
+		}
 
-		width = scaled_width;
-		height = scaled_height;
-		CreateTexture(data.data());
+		CreatePlaceholderTexture();
+		StartLoading(width, height);
 	}
 
 	Image::Image(Image&& image) noexcept :
 		x{ image.x },
 		y{ image.y },
 		size{ image.size },
+		id{ image.id },
+		loading{ std::move(image.loading) },
+		file_path{ std::move(image.file_path) },
+		file_resolution{ image.file_resolution },
+		resize_settings{ image.resize_settings },
+		pixels_key{ std::move(image.pixels_key) },
 		width{ image.width },
 		height{ image.height },
 		color{ image.color },
-		texture{ image.texture }
+		texture{ std::move(image.texture) },
+		placeholder{ image.placeholder }
 	{
-		image.texture = nullptr;
 	}
 
 	Image::~Image()
 	{
-		if (texture != nullptr) SDL_DestroyTexture(texture);
+		CancelLoading();
 	}
 
-	void Image::Render(SDL_Renderer* renderer) const
+	void Image::UpdateTextures()
 	{
-		if (texture == nullptr) return;
+		if (texture != nullptr) texture->UpdateMips();
 
-		const SDL_Rect start_rect{ x, y, size.x, size.y };
+		if (loading == nullptr || !loading->finished) return;
+
+		if (!loading->cancelled)
+		{
+			if (loading->pixels == nullptr) std::cout << "Failed to load image" << '\n';
+			else
+			{
+				// The user might have already resized the placeholder, so keep that size
+				const SDL_Point placeholder_size = size;
+				SetTexture(TextureCache::Get(TextureCache::MakeImageKey(loading->key), [this] { return loading->pixels; }));
+				size = placeholder_size;
+				pixels_key = loading->key;
+			}
+		}
+
+		loading.reset();
+	}
+
+	void Image::CancelLoading()
+	{
+		if (loading == nullptr) return;
+
+		loading->cancelled = true;
+		loading.reset();
+	}
+
+	float Image::GetLoadingProgress() const
+	{
+		return loading != nullptr ? loading->progress.load() : 1.0f;
+	}
+
+	void Image::Resample()
+	{
+		if (file_path.empty() || size.x <= 0 || size.y <= 0) return;
+
+		CancelLoading();
+		StartLoading(size.x, size.y);
+	}
+
+	void Image::StartLoading(const int target_width, const int target_height)
+	{
+		// Full resolution pixels are cached without a size, the same way the loader finds them
+		const bool full_resolution = target_width == file_resolution.x && target_height == file_resolution.y;
+		const ImageCache::Key key = full_resolution ? ImageCache::MakeKey(file_path) : ImageCache::MakeKey(file_path, target_width, target_height, resize_settings);
+
+		// Another layer showing the same file at the same size already has everything
+		if (TextureCache::Handle shared_texture = TextureCache::Find(TextureCache::MakeImageKey(key)))
+		{
+			const SDL_Point previous_size = size;
+			SetTexture(std::move(shared_texture));
+			if (previous_size.x > 0 && previous_size.y > 0) size = previous_size;
+			pixels_key = key;
+			return;
+		}
+
+		loading = std::make_shared<LoadState>();
+		loading->key = key;
+		std::thread{ &AsyncLoad, loading, file_path, target_width, target_height, resize_settings }.detach();
+	}
+
+	void Image::Render(SDL_Renderer* renderer, const SDL_FPoint& offset) const
+	{
+		if (texture == nullptr || !texture->IsValid()) return;
+
+		const SDL_Rect start_rect = GetRect();
 		SDL_FRect float_rect;
 		SDL_RectToFRect(&start_rect, &float_rect);
+		float_rect.x += offset.x;
+		float_rect.y += offset.y;
+
+		// Other layers might draw the same texture with their own color, so it's only tinted for this draw
+		const Renderer::TiledTexture& level = texture->Get(float_rect.w);
+		level.SetColorMod(color & 0xFF, (color >> 8) & 0xFF, (color >> 16) & 0xFF);
+		level.SetAlphaMod((color >> 24) & 0xFF);
+		level.Render(renderer, float_rect);
+		level.SetColorMod(0xFF, 0xFF, 0xFF);
+		level.SetAlphaMod(0xFF);
+	}
+
+	SDL_Texture* Image::GetPreviewTexture(const float draw_width) const
+	{
+		return texture != nullptr ? texture->GetPreview(draw_width) : nullptr;
+	}
 
-		SDL_RenderTexture(renderer, texture, nullptr, &float_rect);
+	std::shared_ptr<const ImageCache::Pixels> Image::GetPixels() const
+	{
+		return texture != nullptr && !placeholder ? texture->GetPixels() : nullptr;
+	}
+
+	bool Image::IsVisibleAt(const SDL_FPoint& canvas_position) const
+	{
+		if (size.x <= 0 || size.y <= 0) return false;
+
+		const float u = (canvas_position.x - static_cast<float>(x)) / static_cast<float>(size.x);
+		const float v = (canvas_position.y - static_cast<float>(y)) / static_cast<float>(size.y);
+		if (u < 0.0f || u >= 1.0f || v < 0.0f || v >= 1.0f) return false;
+
+		return texture == nullptr || placeholder || texture->GetAlphaMask().IsVisible(u, v);
 	}
 
 	SDL_FRect Image::GetScreenRect() const
@@ -213,45 +308,41 @@ namespace Image
 		return float_rect;
 	}
 
-	void Image::SetColor(const uint32_t new_color)
+	void Image::SetId(const uint64_t new_id)
 	{
-		color = new_color;
-
-		const uint8_t red = color & 0xFF;
-		const uint8_t green = (color >> 8) & 0xFF;
-		const uint8_t blue = (color >> 16) & 0xFF;
-		SDL_SetTextureColorMod(texture, red, green, blue);
-
-		const uint8_t alpha = (color >> 24) & 0xFF;
-		SDL_SetTextureAlphaMod(texture, alpha);
+		id = new_id;
+		next_id = std::max<uint64_t>(next_id, new_id);
 	}
 
-	void Image::UI()
+	void Image::SetTexture(TextureCache::Handle new_texture)
 	{
-		if (ImGui::DragInt2("Size", &size.x, 0.25f)) size = { std::max<int>(0, size.x), std::max<int>(0, size.y) };
-		ImGui::SameLine();
-		if (ImGui::Button("Reset")) size = { width, height };
+		if (new_texture == nullptr || !new_texture->IsValid()) return;
+
+		texture = std::move(new_texture);
+		width = texture->GetPixels()->width;
+		height = texture->GetPixels()->height;
 
-		ImVec4 temp_color = ImGui::ColorConvertU32ToFloat4(color);
-		if (ImGui::ColorEdit4("Color", &temp_color.x)) SetColor(ImGui::ColorConvertFloat4ToU32(temp_color));
+		placeholder = false;
+		size = { width, height };
 	}
 
-	void Image::CreateTexture(void* data)
+	void Image::CreatePlaceholderTexture()
 	{
-		SDL_Surface* surface = SDL_CreateSurfaceFrom(width, height, SDL_PIXELFORMAT_RGBA32, data, 4 * width);
-		if (surface == nullptr)
+		TextureCache::Handle placeholder_texture = TextureCache::Get(PLACEHOLDER_KEY, []
+			{
+				const auto* bytes = reinterpret_cast<const uint8_t*>(&PLACEHOLDER_COLOR);
+				return std::make_shared<const ImageCache::Pixels>(1, 1, std::vector<uint8_t>(bytes, bytes + sizeof(PLACEHOLDER_COLOR)));
+			});
+
+		if (placeholder_texture == nullptr || !placeholder_texture->IsValid())
 		{
-			std::cout << "Failed to create surface: " << SDL_GetError() << '\n';
+			std::cout << "Failed to create placeholder texture: " << SDL_GetError() << '\n';
 			return;
 		}
 
-		if (texture != nullptr) SDL_DestroyTexture(texture);
-
-		texture = SDL_CreateTextureFromSurface(Renderer::GetRenderer(), surface);
-		if (texture == nullptr) std::cout << "Failed to update texture: " << SDL_GetError() << '\n';
-
-		SDL_DestroySurface(surface);
-
+		// Stretched over the size the real pixels will have
+		texture = std::move(placeholder_texture);
+		placeholder = true;
 		size = { width, height };
 	}
 
@@ -260,344 +351,447 @@ namespace Image
 		Text::CreateTextTexture();
 	}
 
-	void Text::UI()
-	{
-		UISettings();
-
-		ImGui::Text("Text:");
-		if (ImGui::InputTextMultiline("##", &text, ImGui::GetContentRegionAvail())) CreateTextTexture();
-	}
-
 	void Text::CreateTextTexture()
 	{
-		const uint32_t color_alpha = text_color >> 24;
-		const uint32_t color_rgb = text_color & 0x00FFFFFF;
-
-		const std::vector<uint8_t>& bitmap_data = font->CreateTextBitmap(text, line_height, width, height);
-		std::vector<uint32_t> data(bitmap_data.size(), bg_color);
-
-		for (size_t i = 0; i < bitmap_data.size(); i++)
-		{
-			const uint32_t alpha = color_alpha * bitmap_data.at(i) / 255;
-			uint32_t& data_value = data.at(i);
-			data_value = AddColors(color_rgb + (alpha << 24), data_value);
-		}
-
-		CreateTexture(data.data());
+		RasterizeText(text);
 	}
 
-	void Text::UIFontSelect()
+	void Text::RasterizeText(const std::string& string)
 	{
-		static std::vector<Fonts::FontPath> available_fonts;
-		if (ImGui::BeginCombo("Font", font->GetPath().GetName().c_str()))
-		{
-			if (available_fonts.empty()) available_fonts = Fonts::AvailableFonts();
+		const Profiler::ScopedTimer timer{ Profiler::Stage::Text };
+		Profiler::Count(Profiler::Counter::TextTextures);
 
-			if (ImSearch::BeginSearch())
+		// Duplicated layers and texts that were changed back only need the texture that is already there
+		const std::string key = TextureCache::MakeTextKey(font->GetPath().GetPath(), line_height, string, text_color, bg_color);
+		SetTexture(TextureCache::Get(key, [this, &string]
 			{
-				ImSearch::SearchBar();
+				const uint32_t color_alpha = text_color >> 24;
+				const uint32_t color_rgb = text_color & 0x00FFFFFF;
 
-				for (const auto& available_font : available_fonts)
+				int bitmap_width, bitmap_height;
+				const std::vector<uint8_t>& bitmap_data = font->CreateTextBitmap(string, line_height, bitmap_width, bitmap_height);
+
+				ImageCache::Pixels pixels{ bitmap_width, bitmap_height };
+				pixels.data.resize(bitmap_data.size() * 4);
+
+				uint32_t* data = reinterpret_cast<uint32_t*>(pixels.data.data());
+				for (size_t i = 0; i < bitmap_data.size(); i++)
 				{
-					ImSearch::SearchableItem(available_font.GetName().c_str(),
-						[this, &available_font](const char* name)
-						{
-							if (ImGui::Selectable(name)) SetFont(GetFont(available_font));
-						}
-					);
+					const uint32_t alpha = color_alpha * bitmap_data.at(i) / 255;
+					data[i] = AddColors(color_rgb + (alpha << 24), bg_color);
 				}
 
-				ImSearch::EndSearch();
-			}
-			ImGui::EndCombo();
-		}
-		else if (!available_fonts.empty()) available_fonts.clear();
+				return std::make_shared<const ImageCache::Pixels>(std::move(pixels));
+			}));
 	}
 
-	void Text::UISettings()
+	DateTimeText::DateTimeText() : timezones{ current_zone()->name() }
 	{
-		UIFontSelect();
+		text = "hh:mmap TMZCITY";
+		DateTimeText::CreateTextTexture();
+	}
 
-		ImVec4 temp_color = ImGui::ColorConvertU32ToFloat4(text_color);
-		if (ImGui::ColorEdit4("Color", &temp_color.x)) SetTextColor(ImGui::ColorConvertFloat4ToU32(temp_color));
+	void DateTimeText::SetTimezones(const std::vector<std::string>& names)
+	{
+		timezones.clear();
+		for (const std::string& name : names)
+		{
+			// The database owns the names, so the views stay valid
+			try
+			{
+				timezones.push_back(locate_zone(name)->name());
+			}
+			catch (const std::runtime_error&)
+			{
+				std::cout << "Unknown time zone: " << name << '\n';
+			}
+		}
 
-		ImVec4 temp_bg_color = ImGui::ColorConvertU32ToFloat4(bg_color);
-		if (ImGui::ColorEdit4("Background color", &temp_bg_color.x)) SetBgColor(ImGui::ColorConvertFloat4ToU32(temp_bg_color));
+		CreateTextTexture();
+	}
 
-		if (ImGui::DragFloat("Scale", &line_height, 1.0f, 1.0f, std::numeric_limits<float>::max())) CreateTextTexture();
+	void DateTimeText::CreateTextTexture()
+	{
+		RasterizeText(FormatDateTime(text, timezones, date_time, lower_am_pm));
+	}
 
-		ImGui::Separator();
+	void DateTimeText::SetLive(const bool new_live)
+	{
+		live = new_live;
+		UpdateClock();
 	}
 
-	DateTimeText::DateTimeText() : timezones{ current_zone()->name() }
+	void DateTimeText::UpdateClock()
 	{
-		text = "hh:mmap TMZCITY";
-		DateTimeText::CreateTextTexture();
+		if (!live) return;
+
+		const local_time<seconds> previous = date_time.GetTimePoint();
+		date_time.MakeCurrentDateTime();
+		if (date_time.GetTimePoint() != previous) CreateTextTexture();
 	}
 
-	void DateTimeText::UI()
+	std::optional<milliseconds> UpdateLiveClocks()
 	{
-		UISettings();
+		bool any_live = false;
+		for (const auto& image : images)
+		{
+			auto* date_time_text = dynamic_cast<DateTimeText*>(image.get());
+			if (date_time_text == nullptr || !date_time_text->IsLive()) continue;
 
-		bool changed = false;
-		changed |= UITimezoneSelector();
+			date_time_text->UpdateClock();
+			any_live = true;
+		}
+
+		if (!any_live) return std::nullopt;
+
+		// Clocks only show whole seconds, so nothing changes before the next one starts
+		const milliseconds into_second = duration_cast<milliseconds>(system_clock::now().time_since_epoch()) % 1s;
+		return 1s - into_second;
+	}
 
-		if (ImGui::InputText("Formatting", &text)) CreateTextTexture();
-		ImGui::SameLine();
+	Canvas::Canvas(Image&& image) : image{ std::move(image) }
+	{
+		CreateRenderTarget();
+	}
 
-		static bool show_format_window = false;
-		ImGui::TextDisabled("(?)");
-		if (ImGui::IsItemClicked()) show_format_window = true;
+	Canvas::Canvas(const std::filesystem::path& path, const float scaling, const ImageResize::Settings& resize_settings) : image{ path, scaling, resize_settings }, scaling{ scaling }
+	{
+		CreateRenderTarget();
+	}
 
-		if (show_format_window) UIFormatWindow(show_format_window);
+	void Canvas::Composite(SDL_Renderer* renderer)
+	{
+		if (!IsValid()) return;
 
-		changed |= ImGui::Checkbox("LowerCase AM/PM", &lower_am_pm);
+		current_layers.Clear();
+		current_layers.Add(image);
+		for (const auto& layer : images) current_layers.Add(*layer);
 
-		ImGui::Separator();
+		// The canvas image itself can't be dragged, so it is never this
+		const auto dragged = std::find(current_layers.images.begin() + 1, current_layers.images.end(), dragged_layer);
+		const size_t dragged_index = dragged_layer != nullptr && dragged != current_layers.images.end() ? static_cast<size_t>(dragged - current_layers.images.begin()) : 0;
 
-		if (ImGui::Button("Set current time"))
+		// Compared by index, so reordering layers also dirties both of their spots
+		bool changed = false;
+		bool others_changed = false;
+		for (size_t i = 0; i < std::max<size_t>(current_layers.GetSize(), composited_layers.GetSize()); i++)
 		{
-			date_time.MakeCurrentDateTime();
+			const bool was_composited = i < composited_layers.GetSize();
+			const bool is_composited = i < current_layers.GetSize();
+			if (was_composited && is_composited && composited_layers.IsSame(i, current_layers, i)) continue;
+
+			if (was_composited) MarkDirty(composited_layers.rects.at(i));
+			if (is_composited) MarkDirty(current_layers.rects.at(i));
 			changed = true;
+			others_changed |= i != dragged_index;
 		}
 
-		year_month_day date = date_time.GetDate();
-		changed |= DragDate("Date", date);
+		std::swap(composited_layers, current_layers);
+		if (changed) layer_grid.Build(composited_layers.rects, image.GetWidth(), image.GetHeight());
 
-		hh_mm_ss time = date_time.GetTime();
-		changed |= DragTime("Time", time);
+		// Anything but the dragged layer changing means the flattened layers are out of date
+		if (flattened_index != 0 && (dragged_index != flattened_index || others_changed)) ReleaseFlattened();
+		if (dragged_index != 0 && flattened_index == 0) Flatten(renderer, dragged_index);
 
-		if (changed)
-		{
-			date_time = { date, time };
-			CreateTextTexture();
-		}
-	}
+		if (dirty_rects.empty()) return;
 
-	bool DateTimeText::UITimezoneSelector()
-	{
-		bool changed = false;
+		SDL_Texture* previous_target = SDL_GetRenderTarget(renderer);
+		uint8_t red, green, blue, alpha;
+		SDL_GetRenderDrawColor(renderer, &red, &green, &blue, &alpha);
+		SDL_BlendMode blend_mode;
+		SDL_GetRenderDrawBlendMode(renderer, &blend_mode);
 
-		for (size_t i = 0; i < timezones.size(); i++)
-		{
-			ImGui::PushID(static_cast<int>(i));
+		// Clearing only part of a tile needs a fill, SDL_RenderClear ignores the clip rect
+		SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+		SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
 
-			const std::string_view& timezone = timezones.at(i);
+		const std::vector<Renderer::TiledTexture::Tile>& tiles = target.GetTiles();
+		for (size_t tile_index = 0; tile_index < tiles.size(); tile_index++)
+		{
+			const Renderer::TiledTexture::Tile& tile = tiles.at(tile_index);
 
-			ImGui::BeginDisabled(i == 0);
-			if (ImGui::SmallButton("-"))
+			bool target_set = false;
+			for (const SDL_Rect& dirty_rect : dirty_rects)
 			{
-				std::swap(timezones.at(i - 1), timezones.at(i));
-				changed = true;
-			}
-			ImGui::EndDisabled();
+				SDL_Rect tile_dirty_rect;
+				if (!SDL_GetRectIntersection(&dirty_rect, &tile.rect, &tile_dirty_rect)) continue;
 
-			ImGui::SameLine();
+				if (!target_set)
+				{
+					SDL_SetRenderTarget(renderer, tile.texture);
+					target_set = true;
+				}
 
-			ImGui::BeginDisabled(i == timezones.size() - 1);
-			if (ImGui::SmallButton("+"))
-			{
-				std::swap(timezones.at(i), timezones.at(i + 1));
-				changed = true;
-			}
-			ImGui::EndDisabled();
+				// Everything below is in tile coordinates
+				const SDL_Rect clip_rect{ tile_dirty_rect.x - tile.rect.x, tile_dirty_rect.y - tile.rect.y, tile_dirty_rect.w, tile_dirty_rect.h };
+				SDL_SetRenderClipRect(renderer, &clip_rect);
 
-			ImGui::SameLine();
+				SDL_FRect float_clip_rect;
+				SDL_RectToFRect(&clip_rect, &float_clip_rect);
+				const SDL_FPoint offset{ static_cast<float>(-tile.rect.x), static_cast<float>(-tile.rect.y) };
 
-			ImGui::Text("%s", timezone.data());
-			ImGui::SameLine();
-			if (ImGui::SmallButton("Remove"))
-			{
-				timezones.erase(timezones.begin() + static_cast<int64_t>(i));
-				--i;
+				if (flattened_index != 0)
+				{
+					// Copying the layers below also clears, the ones above were blended into transparency so they are premultiplied
+					SDL_RenderTexture(renderer, flattened_below.GetTiles().at(tile_index).texture, &float_clip_rect, &float_clip_rect);
+					if (SDL_HasRectIntersection(&composited_layers.rects.at(flattened_index), &tile_dirty_rect)) composited_layers.images.at(flattened_index)->Render(renderer, offset);
+					SDL_RenderTexture(renderer, flattened_above.GetTiles().at(tile_index).texture, &float_clip_rect, &float_clip_rect);
 
-				changed = true;
+					SDL_GetRectUnion(&drag_damage, &tile_dirty_rect, &drag_damage);
+					continue;
+				}
+
+				SDL_RenderFillRect(renderer, &float_clip_rect);
+
+				layer_grid.FindOverlapping(composited_layers.rects, tile_dirty_rect, overlapping_layers);
+				for (const size_t layer : overlapping_layers) composited_layers.images.at(layer)->Render(renderer, offset);
 			}
-			ImGui::PopID();
+
+			if (target_set) SDL_SetRenderClipRect(renderer, nullptr);
 		}
 
-		static std::string_view selected_timezone;
-		if (ImGui::BeginCombo("Timezone", selected_timezone.data()))
+		SDL_SetRenderDrawBlendMode(renderer, blend_mode);
+		SDL_SetRenderDrawColor(renderer, red, green, blue, alpha);
+		SDL_SetRenderTarget(renderer, previous_target);
+
+		dirty_rects.clear();
+		valid_mip_count = 0;
+	}
+
+	void Canvas::Flatten(SDL_Renderer* renderer, const size_t dragged_index)
+	{
+		flattened_below = Renderer::TiledTexture::CreateTarget(image.GetWidth(), image.GetHeight());
+		flattened_above = Renderer::TiledTexture::CreateTarget(image.GetWidth(), image.GetHeight());
+		if (!flattened_below.IsValid() || !flattened_above.IsValid())
 		{
-			if (ImSearch::BeginSearch())
-			{
-				ImSearch::SearchBar();
+			// Dragging still works without them, just like any other change
+			std::cout << "Failed to create flattened layers: " << SDL_GetError() << '\n';
+			flattened_below = {};
+			flattened_above = {};
+			return;
+		}
 
-				const auto& timezone_database = get_tzdb();
-				const auto& available_timezones = timezone_database.zones;
+		flattened_below.SetBlendMode(SDL_BLENDMODE_NONE);
+		flattened_above.SetBlendMode(SDL_BLENDMODE_BLEND_PREMULTIPLIED);
 
-				for (const auto& timezone : available_timezones)
+		SDL_Texture* previous_target = SDL_GetRenderTarget(renderer);
+		uint8_t red, green, blue, alpha;
+		SDL_GetRenderDrawColor(renderer, &red, &green, &blue, &alpha);
+		SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+
+		const auto flatten = [&](const Renderer::TiledTexture& flattened, const size_t first, const size_t last)
+			{
+				for (const Renderer::TiledTexture::Tile& tile : flattened.GetTiles())
 				{
-					const std::string_view timezone_name = timezone.name();
-					if (std::ranges::find(timezones, timezone_name) != timezones.end()) continue;
-
-					ImSearch::SearchableItem(timezone_name.data(),
-						[timezone_name](const char* name)
-						{
-							if (ImGui::Selectable(name))
-							{
-								selected_timezone = timezone_name;
-							}
-						});
+					SDL_SetRenderTarget(renderer, tile.texture);
+					SDL_RenderClear(renderer);
+
+					const SDL_FPoint offset{ static_cast<float>(-tile.rect.x), static_cast<float>(-tile.rect.y) };
+					layer_grid.FindOverlapping(composited_layers.rects, tile.rect, overlapping_layers);
+					for (const size_t layer : overlapping_layers)
+					{
+						if (layer >= first && layer < last) composited_layers.images.at(layer)->Render(renderer, offset);
+					}
 				}
+			};
 
-				ImSearch::EndSearch();
-			}
-			ImGui::EndCombo();
-		}
+		flatten(flattened_below, 0, dragged_index);
+		flatten(flattened_above, dragged_index + 1, composited_layers.GetSize());
 
-		ImGui::SameLine();
+		SDL_SetRenderDrawColor(renderer, red, green, blue, alpha);
+		SDL_SetRenderTarget(renderer, previous_target);
 
-		ImGui::BeginDisabled(selected_timezone.empty());
-		if (ImGui::SmallButton("+"))
-		{
-			timezones.push_back(selected_timezone);
-			selected_timezone = {};
-			changed = true;
-		}
-		ImGui::EndDisabled();
-
-		return changed;
+		flattened_index = dragged_index;
 	}
 
-	void DateTimeText::CreateTextTexture()
+	void Canvas::ReleaseFlattened()
 	{
-		const uint32_t color_alpha = text_color >> 24;
-		const uint32_t color_rgb = text_color & 0x00FFFFFF;
+		flattened_below = {};
+		flattened_above = {};
+		flattened_index = 0;
 
-		std::string formated_text = FormatDateTime(text, timezones, date_time, lower_am_pm);
-		const std::vector<uint8_t>& bitmap_data = font->CreateTextBitmap(formated_text, line_height, width, height);
-		std::vector<uint32_t> data(bitmap_data.size(), bg_color);
+		// Blending the flattened layers rounds a little differently, so whatever was drawn from them gets drawn again properly
+		if (!SDL_RectEmpty(&drag_damage)) MarkDirty(drag_damage);
+		drag_damage = {};
+	}
 
-		for (size_t i = 0; i < bitmap_data.size(); i++)
+	bool Canvas::CompositeOnCpu(ImageCache::Pixels& output) const
+	{
+		std::vector<Compositor::Layer> layers;
+		layers.reserve(images.size() + 1);
+		layers.push_back({ image.GetPixels(), image.GetRect(), image.GetColor() });
+		for (const auto& layer : images)
 		{
-			const uint32_t alpha = color_alpha * bitmap_data.at(i) / 255;
-			uint32_t& data_value = data.at(i);
-			data_value = AddColors(color_rgb + (alpha << 24), data_value);
+			layers.push_back({ layer->GetPixels(), layer->GetRect(), layer->GetColor() });
 		}
 
-		CreateTexture(data.data());
+		output.width = image.GetWidth();
+		output.height = image.GetHeight();
+		output.data.resize(4 * static_cast<size_t>(output.width) * static_cast<size_t>(output.height));
+
+		return Compositor::Composite(layers, output.width, output.height, output.data.data());
 	}
 
-	void DateTimeText::UIFormatWindow(bool& show_format_window) const
+	std::optional<size_t> Canvas::FindLayerAt(const SDL_FPoint& screen_position) const
 	{
-		if (ImGui::Begin("Formats", &show_format_window))
-		{
-			if (ImGui::BeginTable("Formats", 3, ImGuiTableFlags_Resizable | ImGuiTableFlags_Borders))
-			{
-				ImGui::TableSetupColumn("Format");
-				ImGui::TableSetupColumn("Result");
-				ImGui::TableSetupColumn("Description");
-				ImGui::TableHeadersRow();
+		const float scaling = Renderer::zoom * base_scale;
+		const SDL_FPoint position{ (screen_position.x - render_offset.x + Renderer::scroll.x) / scaling, (screen_position.y - render_offset.y + Renderer::scroll.y) / scaling };
 
-				const zoned_time zoned_time = date_time.GetZonedTime();
-				for (const auto& formatter : DateTime::date_time_formatters)
-				{
-					ImGui::TableNextRow();
+		// The grid is from the last composite. Layers only change between that and the UI when something went wrong compositing,
+		// in which case going through all of them still works
+		if (composited_layers.GetSize() == images.size() + 1)
+		{
+			const std::optional<size_t> found = layer_grid.FindTopmost(composited_layers.rects, position,
+				[this, &position](const size_t layer) { return composited_layers.images.at(layer)->IsVisibleAt(position); });
 
-					ImGui::TableSetColumnIndex(0);
-					ImGui::Text("%s", formatter.custom_format.data());
+			// The canvas image itself can't be picked
+			if (!found || *found == 0) return std::nullopt;
+			if (composited_layers.images.at(*found) == images.at(*found - 1).get()) return *found - 1;
+		}
 
-					ImGui::TableSetColumnIndex(1);
-					ImGui::PushID(formatter.custom_format.data());
+		for (size_t i = images.size() - 1; i < images.size(); i--)
+		{
+			if (images.at(i)->IsVisibleAt(position)) return i;
+		}
 
-					std::string formatted_date_time{ formatter.replacement_format };
-					formatted_date_time = std::vformat("{:" + formatted_date_time += '}', std::make_format_args(zoned_time));
-					ImGui::Text("%s", formatted_date_time.c_str());
+		return std::nullopt;
+	}
 
-					ImGui::PopID();
+	const Renderer::TiledTexture& Canvas::GetDisplayTexture(const float draw_width)
+	{
+		SDL_Renderer* renderer = Renderer::GetRenderer();
+		SDL_Texture* previous_target = SDL_GetRenderTarget(renderer);
 
-					ImGui::TableSetColumnIndex(2);
-					ImGui::Text("%s", formatter.description.data());
+		// Each level is rendered from the previous one with linear filtering, which is exactly a 2x2 average when halving
+		int level_width = image.GetWidth();
+		int level_height = image.GetHeight();
+		for (size_t i = 0; static_cast<float>(level_width / 2) >= draw_width && level_width > 1 && level_height > 1; i++)
+		{
+			level_width /= 2;
+			level_height /= 2;
 
+			if (i == target_mips.size())
+			{
+				Renderer::TiledTexture level = Renderer::TiledTexture::CreateTarget(level_width, level_height);
+				if (!level.IsValid())
+				{
+					std::cout << "Failed to create canvas mip level: " << SDL_GetError() << '\n';
+					break;
 				}
 
-				ImGui::TableNextRow();
+				level.SetScaleMode(SDL_SCALEMODE_LINEAR);
+				target_mips.push_back(std::move(level));
+			}
 
-				ImGui::TableSetColumnIndex(0);
-				ImGui::Text("TMZCITY");
+			// Levels only go stale when compositing changed something
+			if (i < valid_mip_count) continue;
 
-				ImGui::TableSetColumnIndex(1);
-				ImGui::Text("%s", current_zone()->name().data());
+			const Renderer::TiledTexture& source = i == 0 ? target : target_mips.at(i - 1);
+			source.SetBlendMode(SDL_BLENDMODE_NONE);
+			source.SetScaleMode(SDL_SCALEMODE_LINEAR);
 
-				ImGui::TableSetColumnIndex(2);
-				ImGui::Text("The time zone's city name");
+			for (const Renderer::TiledTexture::Tile& tile : target_mips.at(i).GetTiles())
+			{
+				SDL_SetRenderTarget(renderer, tile.texture);
 
-				ImGui::EndTable();
+				const SDL_FRect destination{ static_cast<float>(-tile.rect.x), static_cast<float>(-tile.rect.y), static_cast<float>(level_width), static_cast<float>(level_height) };
+				source.Render(renderer, destination);
 			}
+
+			source.SetBlendMode(SDL_BLENDMODE_BLEND);
+			source.SetScaleMode(i == 0 ? SDL_SCALEMODE_NEAREST : SDL_SCALEMODE_LINEAR);
+
+			valid_mip_count = i + 1;
 		}
-		ImGui::End();
-	}
 
-	Canvas::Canvas(Image&& image) : image{ std::move(image) }
-	{
-		CreateRenderTarget();
-	}
+		SDL_SetRenderTarget(renderer, previous_target);
 
-	Canvas::Canvas(const std::filesystem::path& path, const float scaling) : image{ path, scaling }
-	{
-		CreateRenderTarget();
+		return Renderer::SelectMipLevel(target, target_mips, draw_width);
 	}
 
-	Canvas::~Canvas()
+	bool Canvas::Export(const std::shared_ptr<ExportQueue::Job>& job)
 	{
-		if (IsValid()) SDL_DestroyTexture(target);
+		// The target keeps getting composited into while this export waits, so it gets a copy of its own
+		Renderer::TiledTexture snapshot = target.Copy(Renderer::GetRenderer());
+		if (!snapshot.IsValid())
+		{
+			std::cout << "Failed to copy canvas for export: " << SDL_GetError() << '\n';
+			job->state = ExportQueue::State::Failed;
+			return false;
+		}
+
+		pending_exports.emplace_back(std::move(snapshot), job);
+		return true;
 	}
 
-	void Canvas::UpdateScaleAndOffset(const SDL_FPoint& working_area, const float menu_bar_height)
+	void Canvas::UpdateExports(SDL_Renderer* renderer)
 	{
-		float canvas_height = static_cast<float>(image.GetHeight());
-		base_scale = working_area.y / canvas_height;
+		for (PendingExport& pending_export : pending_exports)
+		{
+			// No reason to stall on the readback for something that was cancelled already
+			if (pending_export.job->cancelled)
+			{
+				pending_export.job->state = ExportQueue::State::Cancelled;
+				continue;
+			}
 
-		const float scale = Renderer::zoom * base_scale;
-		const float canvas_width = static_cast<float>(image.GetWidth()) * scale;
-		canvas_height *= scale;
+			// The readback is moved into the queue, so the pixels are never copied again
+			Renderer::Readback readback = pending_export.snapshot.ReadPixels(renderer);
+			if (!readback.IsValid()) std::cout << "Failed to get canvas pixels: " << SDL_GetError() << '\n';
 
-		content_size = working_area + ImVec2{ std::max<float>(canvas_width, working_area.x), std::max<float>(canvas_height, working_area.y) };
+			ExportQueue::Enqueue(pending_export.job, std::move(readback));
+		}
 
-		render_offset = content_size / 2.0f - ImVec2{ canvas_width, canvas_height } / 2.0f;
-		render_offset.y += menu_bar_height;
+		pending_exports.clear();
 	}
 
-	std::future<void> Canvas::Export(std::string&& path) const
+	void Canvas::CreateRenderTarget()
 	{
-		SDL_Renderer* renderer = Renderer::GetRenderer();
-		SDL_SetRenderTarget(renderer, target);
+		// Without a renderer there is nothing to draw into, CompositeOnCpu works from the layers directly
+		if (Renderer::GetRenderer() == nullptr) return;
 
-		SDL_Surface* canvas_surface = SDL_RenderReadPixels(renderer, nullptr);
-		if (canvas_surface == nullptr)
+		target = Renderer::TiledTexture::CreateTarget(image.GetWidth(), image.GetHeight());
+		if (!target.IsValid())
 		{
-			std::cout << "Failed to get canvas surface: " << SDL_GetError() << '\n';
-			return {};
+			std::cout << "Failed to create canvas target: " << SDL_GetError() << '\n';
+			return;
 		}
 
-		// Copy the data, so it can be moved to a separate thread
-		const int target_width = image.GetWidth();
-		const int target_height = image.GetHeight();
-
-		uint32_t* pixel_data = static_cast<uint32_t*>(canvas_surface->pixels);
-		std::vector data(pixel_data, pixel_data + static_cast<size_t>(target_width) * static_cast<size_t>(target_height));
+		target.SetScaleMode(SDL_SCALEMODE_NEAREST);
 
-		std::future future = std::async(std::launch::async, &AsyncExport, std::move(path), target_width, target_height, std::move(data));
-		SDL_DestroySurface(canvas_surface);
+		// Everything needs to be drawn the first time
+		dirty_rects.clear();
+		MarkDirty({ 0, 0, image.GetWidth(), image.GetHeight() });
 
-		SDL_SetRenderTarget(renderer, nullptr);
-
-		return future;
+		// We should technically also update the scale offset and content size here, but getting that info here isn't easy, 
+		// and it means things will only look wrong for a single frame after creating the canvas
 	}
 
-	void Canvas::CreateRenderTarget()
+	void Canvas::MarkDirty(const SDL_Rect& rect)
 	{
-		target = SDL_CreateTexture(Renderer::GetRenderer(), SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, image.GetWidth(), image.GetHeight());
-		if (target == nullptr)
+		const SDL_Rect canvas_rect{ 0, 0, image.GetWidth(), image.GetHeight() };
+		SDL_Rect dirty_rect;
+		if (!SDL_GetRectIntersection(&rect, &canvas_rect, &dirty_rect)) return;
+
+		// Overlapping rects would redraw the same pixels twice, so they get merged. Merging can make the rect overlap others again
+		for (auto it = dirty_rects.begin(); it != dirty_rects.end();)
 		{
-			std::cout << "Failed to create canvas target: " << SDL_GetError() << '\n';
-			return;
+			if (SDL_HasRectIntersection(&*it, &dirty_rect))
+			{
+				SDL_GetRectUnion(&*it, &dirty_rect, &dirty_rect);
+				dirty_rects.erase(it);
+				it = dirty_rects.begin();
+			}
+			else ++it;
 		}
 
-		SDL_SetTextureScaleMode(target, SDL_SCALEMODE_NEAREST);
+		dirty_rects.push_back(dirty_rect);
 
-		// We should technically also update the scale offset and content size here, but getting that info here isn't easy, 
-		// and it means things will only look wrong for a single frame after creating the canvas
+		// Every rect means drawing all layers in it again, past a few one big rect is cheaper
+		if (dirty_rects.size() > MAX_DIRTY_RECTS)
+		{
+			for (const SDL_Rect& other_rect : dirty_rects) SDL_GetRectUnion(&other_rect, &dirty_rect, &dirty_rect);
+			dirty_rects.assign(1, dirty_rect);
+		}
 	}
 }
@@ -1,10 +1,19 @@
 #pragma once
 
 #include <cstdint>
+#include <chrono>
+#include <memory>
+#include <optional>
 #include <string>
 
 #include "Fonts.hpp"
 #include "DateTime.hpp"
+#include "ImageCache.hpp"
+#include "ImageResize.hpp"
+#include "ExportQueue.hpp"
+#include "LayerGrid.hpp"
+#include "TextureCache.hpp"
+#include "TiledTexture.hpp"
 
 namespace std
 {
@@ -12,9 +21,6 @@ namespace std
 	{
 		class path;
 	}
-
-	template<typename>
-	class future;
 }
 
 struct SDL_Texture;
@@ -22,12 +28,14 @@ struct SDL_Renderer;
 
 namespace Image
 {
+	struct LoadState; // Shared between an image and the worker thread decoding it
+
 	class Image
 	{
 	public:
 		Image() = default;
 		Image(void* data, int width, int height);
-		explicit Image(const std::filesystem::path& file_path, float scaling = 1.0f);
+		explicit Image(const std::filesystem::path& file_path, float scaling = 1.0f, const ImageResize::Settings& resize_settings = {});
 
 		Image(Image&) = delete;
 		Image(Image&& image) noexcept;
@@ -36,16 +44,57 @@ namespace Image
 
 		virtual ~Image();
 
-		void Render(SDL_Renderer* renderer) const;
+		// Offset is added to the position, used to draw into the tiles of the canvas
+		void Render(SDL_Renderer* renderer, const SDL_FPoint& offset = {}) const;
 		[[nodiscard]] SDL_FRect GetScreenRect() const;
-		[[nodiscard]] void* GetTexture() const { return texture; }
+		[[nodiscard]] SDL_Rect GetRect() const { return { x, y, size.x, size.y }; }
+
+		// Whether the layer has a visible pixel at a point on the canvas. Placeholders and textures without an alpha mask yet count as visible everywhere in their rect
+		[[nodiscard]] bool IsVisibleAt(const SDL_FPoint& canvas_position) const;
+
+		// Only mip levels that fit in a single texture qualify, for ImGui. Can be nullptr for huge images without mip levels (yet). Untinted, draw it with GetColor()
+		[[nodiscard]] SDL_Texture* GetPreviewTexture(float draw_width) const;
+
+		// Changes every time the pixels this image draws change, so the canvas knows what to redraw
+		[[nodiscard]] uint64_t GetTextureGeneration() const { return texture != nullptr ? texture->GetGeneration() : 0; }
 		[[nodiscard]] int GetWidth() const { return width; }
 		[[nodiscard]] int GetHeight() const { return height; }
 
-		void SetColor(const uint32_t new_color);
+		// The RGBA pixels the texture was made from, kept for compositing on the CPU. nullptr while there's only a placeholder
+		[[nodiscard]] std::shared_ptr<const ImageCache::Pixels> GetPixels() const;
+
+		// Textures can be shared with other layers, so the color is only applied while rendering
+		void SetColor(const uint32_t new_color) { color = new_color; }
 		[[nodiscard]] uint32_t GetColor() const { return color; }
 
+		// Unique while the layer lives, layouts and the undo history use it to find layers again after they were moved around.
+		// Setting it makes sure layers made later don't get the same one
+		[[nodiscard]] uint64_t GetId() const { return id; }
+		void SetId(uint64_t new_id);
+
+		// Images loaded from a file are decoded on a worker thread, until then a placeholder texture is shown. Mip levels are also made on a worker.
+		// UpdateTextures uploads the pixels once they are ready, so it must be called from the main thread.
+		void UpdateTextures();
+		void CancelLoading();
+		[[nodiscard]] bool IsLoading() const { return loading != nullptr; }
+		[[nodiscard]] bool IsPlaceholder() const { return placeholder; }
+		[[nodiscard]] float GetLoadingProgress() const;
+
+		// Resamples the file to the current size in the background, until then the GPU just stretches the old texture
+		void Resample();
+
+		// Empty for images that weren't loaded from a file
+		[[nodiscard]] const std::string& GetFilePath() const { return file_path; }
+		[[nodiscard]] SDL_Point GetFileResolution() const { return file_resolution; }
+		[[nodiscard]] const ImageResize::Settings& GetResizeSettings() const { return resize_settings; }
+
+		// The image cache key the pixels were loaded under, which has the file as it was back then. Only valid once GetPixels isn't nullptr
+		[[nodiscard]] const ImageCache::Key& GetPixelsKey() const { return pixels_key; }
+
+		// The UI lives in ImageUI.cpp, which the command line renderer leaves out together with ImGui
+#ifndef BANNER_HEADLESS
 		virtual void UI();
+#endif
 
 		int x = 0;
 		int y = 0;
@@ -53,13 +102,28 @@ namespace Image
 		SDL_Point size{ 0, 0 };
 
 	protected:
-		void CreateTexture(void* data);
+		// Textures come from the texture cache, so layers showing the same pixels share them
+		void SetTexture(TextureCache::Handle new_texture);
+		void CreatePlaceholderTexture();
+		void StartLoading(int target_width, int target_height);
+
+		inline static uint64_t next_id{ 0 };
+		uint64_t id{ ++next_id };
+
+		std::shared_ptr<LoadState> loading;
+
+		// Only set for images loaded from a file
+		std::string file_path;
+		SDL_Point file_resolution{ 0, 0 };
+		ImageResize::Settings resize_settings;
+		ImageCache::Key pixels_key;
 
 		int width{ 0 };
 		int height{ 0 };
 
 		uint32_t color{ 0xFFFFFFFF };
-		SDL_Texture* texture{ nullptr };
+		TextureCache::Handle texture;
+		bool placeholder{ false };
 	};
 
 	class Text : public Image
@@ -110,10 +174,13 @@ namespace Image
 
 		const Fonts::FontPath& GetFontPath() const { return font->GetPath(); }
 
+#ifndef BANNER_HEADLESS
 		virtual void UI() override;
+#endif
 
 	protected:
 		virtual void CreateTextTexture();
+		void RasterizeText(const std::string& string);
 		void UIFontSelect();
 		void UISettings();
 
@@ -130,7 +197,34 @@ namespace Image
 	public:
 		DateTimeText();
 
+		// Names that aren't in the time zone database are skipped
+		void SetTimezones(const std::vector<std::string>& names);
+		[[nodiscard]] const std::vector<std::string_view>& GetTimezones() const { return timezones; }
+
+		void SetDateTime(const DateTime::DateTime& new_date_time)
+		{
+			date_time = new_date_time;
+			CreateTextTexture();
+		}
+		[[nodiscard]] const DateTime::DateTime& GetDateTime() const { return date_time; }
+
+		void SetLowerAmPm(const bool lower)
+		{
+			lower_am_pm = lower;
+			CreateTextTexture();
+		}
+		[[nodiscard]] bool GetLowerAmPm() const { return lower_am_pm; }
+
+		// Live clocks show the current time instead of the one that was set, layouts only save that they are live
+		void SetLive(bool new_live);
+		[[nodiscard]] bool IsLive() const { return live; }
+
+		// Moves a live clock to the current time, the text is only rasterized again when the time actually changed
+		void UpdateClock();
+
+#ifndef BANNER_HEADLESS
 		virtual void UI() override;
+#endif
 
 	private:
 		virtual void CreateTextTexture() override;
@@ -141,8 +235,18 @@ namespace Image
 		std::vector<std::string_view> timezones;
 		DateTime::DateTime date_time;
 		bool lower_am_pm = true;
+		bool live = false;
 	};
 
+	// Calls UpdateClock on every live clock, from the main thread once a frame.
+	// Returns how long until the next one changes, so the main loop can sleep until then (nothing when there are no live clocks)
+	std::optional<std::chrono::milliseconds> UpdateLiveClocks();
+
+	bool ResizeSettingsUI(ImageResize::Settings& settings);
+
+	// Image files that would decode to more bytes than this are rejected before decoding
+	inline uint64_t decode_memory_limit{ 2ull * 1024ull * 1024ull * 1024ull };
+
 	inline std::vector<std::unique_ptr<Image>> images;
 
 	inline size_t selection_index = std::numeric_limits<size_t>::max();
@@ -154,16 +258,42 @@ namespace Image
 	struct Canvas
 	{
 		Canvas(Image&& image);
-		Canvas(const std::filesystem::path& path, float scaling);
-		~Canvas();
+		Canvas(const std::filesystem::path& path, float scaling, const ImageResize::Settings& resize_settings);
 
-		[[nodiscard]] bool IsValid() const { return target != nullptr; }
+		[[nodiscard]] bool IsValid() const { return target.IsValid(); }
 
-		SDL_Texture* target{ nullptr };
+		// What the canvas image file was scaled by when loading it, saved in layouts so they load at the exact same size
+		[[nodiscard]] float GetScaling() const { return scaling; }
+
+		// Split into tiles, so banners can be bigger than the max texture size
+		Renderer::TiledTexture target;
+		std::vector<Renderer::TiledTexture> target_mips;
 		Image image;
 
 		void UpdateScaleAndOffset(const SDL_FPoint& working_area, float menu_bar_height);
-		[[nodiscard]] std::future<void> Export(std::string&& path) const;
+
+		// Draws the canvas image and all layers into the target, only the parts something changed in get redrawn.
+		// Does nothing at all when no layer moved, resized, got a new texture, changed color or changed places
+		void Composite(SDL_Renderer* renderer);
+
+		// Draws the same thing into memory without the GPU, which is all there is when running without a renderer
+		[[nodiscard]] bool CompositeOnCpu(ImageCache::Pixels& output) const;
+
+		// While a layer is dragged, the layers below and above it are flattened into a texture each, so every frame of the drag only draws three things.
+		// nullptr when nothing is dragged, the flattened layers are made again whenever another layer changes
+		void SetDraggedLayer(const Image* layer) { dragged_layer = layer; }
+
+		// Index in images of the topmost layer at a point on the screen, nullopt when there is none
+		[[nodiscard]] std::optional<size_t> FindLayerAt(const SDL_FPoint& screen_position) const;
+
+		// Downsamples the composited target on the GPU as far as needed to be drawn draw_width wide, must be called after compositing
+		[[nodiscard]] const Renderer::TiledTexture& GetDisplayTexture(float draw_width);
+
+		// Copies the target on the GPU right away, the pixels get read back on the next frame in UpdateExports
+		bool Export(const std::shared_ptr<ExportQueue::Job>& job);
+
+		// Reads back the exports started on an earlier frame and hands their pixels to the export queue
+		void UpdateExports(SDL_Renderer* renderer);
 
 		float base_scale{ 1.0f };
 		SDL_FPoint render_offset{};
@@ -171,6 +301,81 @@ namespace Image
 
 	private:
 		void CreateRenderTarget();
+		void MarkDirty(const SDL_Rect& rect);
+		void Flatten(SDL_Renderer* renderer, size_t dragged_index);
+		void ReleaseFlattened();
+
+		// What each layer looked like when it was last composited, the canvas image comes first.
+		// Every value has an array of its own, so the grid and picking only have to go through the rects
+		struct LayerTable
+		{
+			std::vector<const Image*> images;
+			std::vector<uint64_t> texture_generations;
+			std::vector<SDL_Rect> rects;
+			std::vector<uint32_t> colors;
+
+			[[nodiscard]] size_t GetSize() const { return images.size(); }
+
+			void Add(const Image& image)
+			{
+				images.push_back(&image);
+				texture_generations.push_back(image.GetTextureGeneration());
+				rects.push_back(image.GetRect());
+				colors.push_back(image.GetColor());
+			}
+
+			void Clear()
+			{
+				images.clear();
+				texture_generations.clear();
+				rects.clear();
+				colors.clear();
+			}
+
+			[[nodiscard]] bool IsSame(const size_t i, const LayerTable& other, const size_t other_i) const
+			{
+				const SDL_Rect& rect = rects.at(i);
+				const SDL_Rect& other_rect = other.rects.at(other_i);
+				return images.at(i) == other.images.at(other_i) && texture_generations.at(i) == other.texture_generations.at(other_i) && colors.at(i) == other.colors.at(other_i) &&
+					rect.x == other_rect.x && rect.y == other_rect.y && rect.w == other_rect.w && rect.h == other_rect.h;
+			}
+		};
+
+		// Waits a frame between copying the target and reading the copy back, so the GPU has time to finish drawing it
+		struct PendingExport
+		{
+			Renderer::TiledTexture snapshot;
+			std::shared_ptr<ExportQueue::Job> job;
+		};
+
+		std::vector<PendingExport> pending_exports;
+
+		LayerTable composited_layers;
+
+		// Only rebuilt when a layer changed, so picking and redrawing don't have to go through every layer
+		LayerGrid layer_grid;
+
+		const Image* dragged_layer{ nullptr };
+
+		// Index in composited_layers of the layer these were flattened around, 0 when there are none (that's the canvas image, which can't be dragged)
+		size_t flattened_index{ 0 };
+		Renderer::TiledTexture flattened_below;
+		Renderer::TiledTexture flattened_above;
+
+		// Everything drawn from the flattened layers
+		SDL_Rect drag_damage{};
+
+		// Both reused every frame, so compositing doesn't allocate
+		LayerTable current_layers;
+		std::vector<size_t> overlapping_layers;
+
+		// Parts of the target (in canvas pixels) that changed since the last composite, they never overlap
+		std::vector<SDL_Rect> dirty_rects;
+
+		float scaling{ 1.0f };
+
+		// Mip levels before this one are up to date with the target
+		size_t valid_mip_count{ 0 };
 	};
 
 	inline std::unique_ptr<Canvas> canvas;
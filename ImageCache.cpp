@@ -0,0 +1,116 @@
+#include "ImageCache.hpp"
+
+#include <list>
+#include <map>
+#include <mutex>
+
+namespace ImageCache
+{
+	namespace
+	{
+		constexpr size_t DEFAULT_MEMORY_BUDGET{ 1024ull * 1024ull * 1024ull };
+
+		struct Entry
+		{
+			Key key;
+			std::shared_ptr<const Pixels> pixels;
+		};
+
+		std::mutex cache_mutex;
+
+		// Front of the list is the most recently used entry
+		std::list<Entry> entries;
+		std::map<Key, std::list<Entry>::iterator> entry_map;
+
+		size_t memory_budget{ DEFAULT_MEMORY_BUDGET };
+		size_t memory_usage{ 0 };
+
+		// Expects the cache mutex to be locked
+		void EvictOverBudget()
+		{
+			while (memory_usage > memory_budget && !entries.empty())
+			{
+				const Entry& entry = entries.back();
+				memory_usage -= entry.pixels->data.size();
+
+				entry_map.erase(entry.key);
+				entries.pop_back();
+			}
+		}
+	}
+
+	Key MakeKey(const std::filesystem::path& path, const int width, const int height, const ImageResize::Settings& resize_settings)
+	{
+		Key key{ .path = path.generic_string(), .width = width, .height = height, .resize_settings = resize_settings };
+
+		std::error_code error;
+		const std::filesystem::file_time_type modified = std::filesystem::last_write_time(path, error);
+		if (!error) key.modified = modified.time_since_epoch().count();
+
+		const uintmax_t file_size = std::filesystem::file_size(path, error);
+		if (!error) key.file_size = file_size;
+
+		return key;
+	}
+
+	std::shared_ptr<const Pixels> Find(const Key& key)
+	{
+		std::lock_guard lock{ cache_mutex };
+
+		const auto found = entry_map.find(key);
+		if (found == entry_map.end()) return nullptr;
+
+		entries.splice(entries.begin(), entries, found->second);
+		return found->second->pixels;
+	}
+
+	std::shared_ptr<const Pixels> Insert(const Key& key, Pixels&& pixels)
+	{
+		auto shared_pixels = std::make_shared<const Pixels>(std::move(pixels));
+
+		const size_t byte_size = shared_pixels->data.size();
+		std::lock_guard lock{ cache_mutex };
+
+		// Not worth throwing out everything else for something that would be evicted right away
+		if (byte_size > memory_budget) return shared_pixels;
+
+		const auto found = entry_map.find(key);
+		if (found != entry_map.end())
+		{
+			// Someone else decoded the same file at the same time, keep theirs so both share one copy
+			entries.splice(entries.begin(), entries, found->second);
+			return found->second->pixels;
+		}
+
+		entries.emplace_front(key, shared_pixels);
+		entry_map.emplace(key, entries.begin());
+		memory_usage += byte_size;
+
+		EvictOverBudget();
+
+		return shared_pixels;
+	}
+
+	void SetMemoryBudget(const size_t bytes)
+	{
+		std::lock_guard lock{ cache_mutex };
+
+		memory_budget = bytes;
+		EvictOverBudget();
+	}
+
+	size_t GetMemoryUsage()
+	{
+		std::lock_guard lock{ cache_mutex };
+		return memory_usage;
+	}
+
+	void Clear()
+	{
+		std::lock_guard lock{ cache_mutex };
+
+		entries.clear();
+		entry_map.clear();
+		memory_usage = 0;
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ImageResize.hpp"
+
+namespace ImageCache
+{
+	// Decoded RGBA pixels, shared between the cache and everyone using them
+	struct Pixels
+	{
+		int width{ 0 };
+		int height{ 0 };
+		std::vector<uint8_t> data;
+	};
+
+	struct Key
+	{
+		std::string path;
+		int64_t modified{ 0 };
+		uintmax_t file_size{ 0 };
+
+		// Resolution of this variant of the file, 0 x 0 means the original resolution
+		int width{ 0 };
+		int height{ 0 };
+		ImageResize::Settings resize_settings{};
+
+		auto operator<=>(const Key&) const = default;
+	};
+
+	// Builds the key for the file as it currently is on disk, so edited files don't hit stale entries
+	[[nodiscard]] Key MakeKey(const std::filesystem::path& path, int width = 0, int height = 0, const ImageResize::Settings& resize_settings = {});
+
+	// Both are thread safe, Find returns nullptr when the key isn't cached
+	[[nodiscard]] std::shared_ptr<const Pixels> Find(const Key& key);
+	std::shared_ptr<const Pixels> Insert(const Key& key, Pixels&& pixels);
+
+	// Least recently used entries are evicted once the cached pixels go over the budget
+	void SetMemoryBudget(size_t bytes);
+	[[nodiscard]] size_t GetMemoryUsage();
+	void Clear();
+}
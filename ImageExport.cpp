@@ -0,0 +1,270 @@
+#include "ImageExport.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+#include <SDL3/SDL_error.h>
+#include <SDL3/SDL_filesystem.h>
+#include <SDL3/SDL_iostream.h>
+
+namespace ImageExport
+{
+	namespace
+	{
+		// Bytes gathered before they get written to the file
+		constexpr size_t WRITE_BUFFER_SIZE{ 64 * 1024 };
+
+		constexpr std::array<uint8_t, 8> QOI_END{ 0, 0, 0, 0, 0, 0, 0, 1 };
+
+		constexpr uint8_t QOI_OP_INDEX{ 0x00 };
+		constexpr uint8_t QOI_OP_DIFF{ 0x40 };
+		constexpr uint8_t QOI_OP_LUMA{ 0x80 };
+		constexpr uint8_t QOI_OP_RUN{ 0xC0 };
+		constexpr uint8_t QOI_OP_RGB{ 0xFE };
+		constexpr uint8_t QOI_OP_RGBA{ 0xFF };
+		constexpr int QOI_MAX_RUN{ 62 };
+
+		struct Pixel
+		{
+			uint8_t r{ 0 };
+			uint8_t g{ 0 };
+			uint8_t b{ 0 };
+			uint8_t a{ 255 };
+
+			bool operator==(const Pixel&) const = default;
+		};
+
+		// Writes for stb go through here, so all formats open their files the same way
+		struct StreamWriter
+		{
+			SDL_IOStream* stream{ nullptr };
+			bool succeeded{ true };
+		};
+
+		void WriteToStream(void* context, void* data, const int size)
+		{
+			StreamWriter& writer = *static_cast<StreamWriter*>(context);
+			if (writer.succeeded && size > 0) writer.succeeded = SDL_WriteIO(writer.stream, data, static_cast<size_t>(size)) == static_cast<size_t>(size);
+		}
+
+		bool WriteWithStb(const std::string& path, const int width, const int height, const uint8_t* pixels, const Settings& settings)
+		{
+			StreamWriter writer{ SDL_IOFromFile(path.c_str(), "wb") };
+			if (writer.stream == nullptr)
+			{
+				std::cout << "Failed to open export file: " << SDL_GetError() << '\n';
+				return false;
+			}
+
+			bool encoded = false;
+			switch (settings.format)
+			{
+			case Format::Jpeg:
+				encoded = stbi_write_jpg_to_func(&WriteToStream, &writer, width, height, 4, pixels, std::clamp<int>(settings.jpeg_quality, 1, 100)) != 0;
+				break;
+
+			case Format::Tga:
+			{
+				// The RLE option is a global in stb, exports can run at the same time
+				static std::mutex tga_mutex;
+				std::lock_guard lock{ tga_mutex };
+
+				stbi_write_tga_with_rle = settings.tga_rle ? 1 : 0;
+				encoded = stbi_write_tga_to_func(&WriteToStream, &writer, width, height, 4, pixels) != 0;
+				break;
+			}
+
+			case Format::Bmp:
+			default:
+				encoded = stbi_write_bmp_to_func(&WriteToStream, &writer, width, height, 4, pixels) != 0;
+				break;
+			}
+
+			const bool succeeded = encoded && writer.succeeded;
+			if (!succeeded) std::cout << "Failed to write export file: " << SDL_GetError() << '\n';
+
+			if (!SDL_CloseIO(writer.stream))
+			{
+				std::cout << "Failed to close export file: " << SDL_GetError() << '\n';
+				return false;
+			}
+
+			return succeeded;
+		}
+
+		// QOI is simple enough that we just write it ourselves, straight to the file a bit at a time
+		bool WriteQoi(const std::string& path, const int width, const int height, const uint8_t* pixels, std::atomic<float>& progress, const std::atomic<bool>& cancelled)
+		{
+			progress = 0.0f;
+			if (width <= 0 || height <= 0 || pixels == nullptr) return false;
+
+			SDL_IOStream* stream = SDL_IOFromFile(path.c_str(), "wb");
+			if (stream == nullptr)
+			{
+				std::cout << "Failed to open export file: " << SDL_GetError() << '\n';
+				return false;
+			}
+
+			std::vector<uint8_t> buffer;
+			buffer.reserve(WRITE_BUFFER_SIZE + 5 * static_cast<size_t>(width) + QOI_END.size());
+
+			const auto write_big_endian = [&buffer](const uint32_t value)
+				{
+					buffer.insert(buffer.end(), { static_cast<uint8_t>(value >> 24), static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value) });
+				};
+
+			buffer.insert(buffer.end(), { 'q', 'o', 'i', 'f' });
+			write_big_endian(static_cast<uint32_t>(width));
+			write_big_endian(static_cast<uint32_t>(height));
+			buffer.push_back(4); // RGBA
+			buffer.push_back(0); // sRGB colors with linear alpha
+
+			bool succeeded = true;
+			const auto flush = [&]
+				{
+					succeeded = succeeded && SDL_WriteIO(stream, buffer.data(), buffer.size()) == buffer.size();
+					buffer.clear();
+				};
+
+			// The spec starts the index all zero (so transparent black), but the previous pixel opaque black
+			std::array<Pixel, 64> seen;
+			seen.fill(Pixel{ 0, 0, 0, 0 });
+			Pixel previous;
+			int run = 0;
+
+			const size_t pixel_count = static_cast<size_t>(width) * static_cast<size_t>(height);
+			for (size_t i = 0; succeeded && i < pixel_count;)
+			{
+				for (const size_t row_end = i + static_cast<size_t>(width); i < row_end; i++)
+				{
+					const uint8_t* source = pixels + 4 * i;
+					const Pixel pixel{ source[0], source[1], source[2], source[3] };
+
+					if (pixel == previous)
+					{
+						run++;
+						if (run == QOI_MAX_RUN || i + 1 == pixel_count)
+						{
+							buffer.push_back(static_cast<uint8_t>(QOI_OP_RUN | (run - 1)));
+							run = 0;
+						}
+					}
+					else
+					{
+						if (run > 0)
+						{
+							buffer.push_back(static_cast<uint8_t>(QOI_OP_RUN | (run - 1)));
+							run = 0;
+						}
+
+						const uint8_t index = static_cast<uint8_t>((pixel.r * 3 + pixel.g * 5 + pixel.b * 7 + pixel.a * 11) % 64);
+						if (seen.at(index) == pixel)
+						{
+							buffer.push_back(static_cast<uint8_t>(QOI_OP_INDEX | index));
+						}
+						else
+						{
+							seen.at(index) = pixel;
+
+							if (pixel.a == previous.a)
+							{
+								const int dr = static_cast<int8_t>(pixel.r - previous.r);
+								const int dg = static_cast<int8_t>(pixel.g - previous.g);
+								const int db = static_cast<int8_t>(pixel.b - previous.b);
+								const int dr_dg = dr - dg;
+								const int db_dg = db - dg;
+
+								if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+								{
+									buffer.push_back(static_cast<uint8_t>(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+								}
+								else if (dr_dg >= -8 && dr_dg <= 7 && dg >= -32 && dg <= 31 && db_dg >= -8 && db_dg <= 7)
+								{
+									buffer.push_back(static_cast<uint8_t>(QOI_OP_LUMA | (dg + 32)));
+									buffer.push_back(static_cast<uint8_t>((dr_dg + 8) << 4 | (db_dg + 8)));
+								}
+								else
+								{
+									buffer.insert(buffer.end(), { QOI_OP_RGB, pixel.r, pixel.g, pixel.b });
+								}
+							}
+							else
+							{
+								buffer.insert(buffer.end(), { QOI_OP_RGBA, pixel.r, pixel.g, pixel.b, pixel.a });
+							}
+						}
+					}
+
+					previous = pixel;
+				}
+
+				// Checked once per row, which is often enough for the progress bar too
+				if (buffer.size() >= WRITE_BUFFER_SIZE)
+				{
+					flush();
+					progress = static_cast<float>(i) / static_cast<float>(pixel_count);
+					if (cancelled) succeeded = false;
+				}
+			}
+
+			buffer.insert(buffer.end(), QOI_END.begin(), QOI_END.end());
+			flush();
+
+			if (!succeeded && !cancelled) std::cout << "Failed to write export file: " << SDL_GetError() << '\n';
+			progress = 1.0f;
+
+			if (!SDL_CloseIO(stream))
+			{
+				std::cout << "Failed to close export file: " << SDL_GetError() << '\n';
+				return false;
+			}
+
+			return succeeded;
+		}
+	}
+
+	Format GetFormat(const std::string& path, const Format fallback)
+	{
+		std::string extension = std::filesystem::path{ path }.extension().string();
+		std::ranges::transform(extension, extension.begin(), [](const unsigned char character) { return static_cast<char>(std::tolower(character)); });
+
+		if (extension == ".jpeg") return Format::Jpeg;
+
+		const auto found = std::ranges::find_if(FORMAT_EXTENSIONS, [&extension](const char* format_extension) { return extension == format_extension; });
+		return found != FORMAT_EXTENSIONS.end() ? static_cast<Format>(found - FORMAT_EXTENSIONS.begin()) : fallback;
+	}
+
+	bool Write(const std::string& path, const int width, const int height, const uint8_t* pixels, std::atomic<float>& progress, const std::atomic<bool>& cancelled, const Settings& settings)
+	{
+		if (cancelled) return false;
+
+		bool succeeded = false;
+		switch (settings.format)
+		{
+		case Format::Png:
+			succeeded = PngWriter::Write(path, width, height, pixels, progress, cancelled, settings.png_compression);
+			break;
+
+		case Format::Qoi:
+			succeeded = WriteQoi(path, width, height, pixels, progress, cancelled);
+			break;
+
+		default:
+			// stb writes everything in one go, so these can only be cancelled before they start
+			progress = 0.0f;
+			succeeded = WriteWithStb(path, width, height, pixels, settings);
+			progress = 1.0f;
+			break;
+		}
+
+		// Half a file is worse than no file
+		if (!succeeded) SDL_RemovePath(path.c_str());
+		return succeeded;
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <compare>
+#include <cstdint>
+#include <string>
+
+#include "PngWriter.hpp"
+
+namespace ImageExport
+{
+	enum class Format : uint8_t
+	{
+		Png,
+		Qoi,	// Lossless like PNG, but many times faster to encode at a somewhat bigger size
+		Jpeg,	// Lossy and drops the alpha channel
+		Tga,
+		Bmp,
+	};
+
+	constexpr std::array<const char*, 5> FORMAT_NAMES{ "PNG", "QOI", "JPEG", "TGA", "BMP" };
+	constexpr std::array<const char*, 5> FORMAT_EXTENSIONS{ ".png", ".qoi", ".jpg", ".tga", ".bmp" };
+
+	struct Settings
+	{
+		Format format{ Format::Png };
+
+		PngWriter::Compression png_compression{ PngWriter::Compression::Balanced };
+
+		// 1 to 100, higher looks better but makes bigger files
+		int jpeg_quality{ 90 };
+
+		// Run length encoding makes TGA files with big flat areas a lot smaller, but not every program can read it
+		bool tga_rle{ false };
+
+		auto operator<=>(const Settings&) const = default;
+	};
+
+	// Returns the format belonging to the extension of path, or fallback if it doesn't have a known one
+	[[nodiscard]] Format GetFormat(const std::string& path, Format fallback);
+
+	// Writes tightly packed RGBA pixels, progress goes from 0 to 1 (in one step for formats that don't report progress).
+	// Setting cancelled stops the export as soon as the format allows it, the unfinished file gets removed like when writing fails
+	bool Write(const std::string& path, int width, int height, const uint8_t* pixels, std::atomic<float>& progress, const std::atomic<bool>& cancelled, const Settings& settings);
+}
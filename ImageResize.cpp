@@ -0,0 +1,66 @@
+#include "ImageResize.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+
+#include <stb_image_resize2.h> // Don't define implementation, should only be defined in Image.cpp
+
+#include "ThreadPool.hpp"
+
+namespace ImageResize
+{
+	namespace
+	{
+		// Splitting tiny resizes costs more in scheduling than it saves
+		constexpr int64_t MIN_PIXELS_PER_SPLIT{ 256 * 256 };
+
+		stbir_filter GetFilter(const Quality quality, const bool upsampling)
+		{
+			switch (quality)
+			{
+			case Quality::Fast:
+				return upsampling ? STBIR_FILTER_POINT_SAMPLE : STBIR_FILTER_BOX;
+
+			case Quality::Balanced:
+				return STBIR_FILTER_TRIANGLE;
+
+			case Quality::HighQuality:
+			default:
+				return upsampling ? STBIR_FILTER_CATMULLROM : STBIR_FILTER_MITCHELL;
+			}
+		}
+	}
+
+	bool Resize(const uint8_t* input, const int input_width, const int input_height, uint8_t* output, const int output_width, const int output_height, const Settings& settings)
+	{
+		const stbir_pixel_layout layout = settings.premultiply_alpha ? STBIR_RGBA : STBIR_4CHANNEL;
+		const stbir_datatype data_type = settings.srgb ? STBIR_TYPE_UINT8_SRGB : STBIR_TYPE_UINT8;
+
+		STBIR_RESIZE resize;
+		stbir_resize_init(&resize, input, input_width, input_height, input_width * 4, output, output_width, output_height, output_width * 4, layout, data_type);
+		stbir_set_filters(&resize, GetFilter(settings.quality, output_width > input_width), GetFilter(settings.quality, output_height > input_height));
+
+		const int64_t output_pixels = static_cast<int64_t>(output_width) * static_cast<int64_t>(output_height);
+		const int64_t wanted_splits = std::clamp<int64_t>(output_pixels / MIN_PIXELS_PER_SPLIT, 1, static_cast<int64_t>(ThreadPool::GetThreadCount()));
+
+		// stb might give us fewer splits than we asked for if the image can't be divided that much
+		const int splits = stbir_build_samplers_with_splits(&resize, static_cast<int>(wanted_splits));
+		if (splits == 0)
+		{
+			std::cout << "Failed to build resize samplers" << '\n';
+			return false;
+		}
+
+		std::atomic<bool> succeeded{ true };
+		ThreadPool::ParallelFor(static_cast<size_t>(splits), [&resize, &succeeded](const size_t split)
+			{
+				if (!stbir_resize_extended_split(&resize, static_cast<int>(split), 1)) succeeded = false;
+			});
+
+		stbir_free_samplers(&resize);
+
+		if (!succeeded) std::cout << "Failed to resize image" << '\n';
+		return succeeded;
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <array>
+#include <compare>
+#include <cstdint>
+
+namespace ImageResize
+{
+	enum class Quality : uint8_t
+	{
+		Fast,			// Box filter when shrinking, point sampling when enlarging
+		Balanced,		// Triangle filter, same as bilinear filtering when enlarging
+		HighQuality,	// Mitchell filter when shrinking, Catmull-Rom when enlarging
+	};
+
+	constexpr std::array<const char*, 3> QUALITY_NAMES{ "Fast", "Balanced", "High quality" };
+
+	struct Settings
+	{
+		Quality quality{ Quality::HighQuality };
+
+		// Filters in linear light instead of on the sRGB values directly, so bright and dark areas mix like they would physically
+		bool srgb{ false };
+
+		// Weighs the colors by their alpha while filtering, so the color of fully transparent pixels doesn't bleed into the edges
+		bool premultiply_alpha{ true };
+
+		auto operator<=>(const Settings&) const = default;
+	};
+
+	// Resizes tightly packed RGBA pixels, the work is split into slices that run on the thread pool
+	bool Resize(const uint8_t* input, int input_width, int input_height, uint8_t* output, int output_width, int output_height, const Settings& settings = {});
+}
@@ -0,0 +1,401 @@
+#include "Image.hpp"
+
+#include <imgui.h>
+#include <imgui/misc/cpp/imgui_stdlib.h>
+#include <imsearch/imsearch.h>
+
+#include "Renderer.hpp"
+
+using namespace std::chrono;
+
+// Everything ImGui about images, kept apart so the command line renderer can build Image.cpp without it
+namespace Image
+{
+	namespace
+	{
+		template <typename Type>
+		bool ClampValue(Type& value, const Type min, const Type max)
+		{
+			if (value < min)
+			{
+				value = min;
+				return true;
+			}
+
+			if (value > max)
+			{
+				value = max;
+				return true;
+			}
+
+			return false;
+		}
+
+		template <typename IntType, typename DateType>
+		bool DragDate(const std::string& label, DateType& value, const int min = 0, const int max = 0, const float speed = 0.25f)
+		{
+			int date = static_cast<int>(static_cast<IntType>(value));
+
+			bool changed = false;
+			if (min != 0 && max != 0) changed |= ClampValue(date, min, max);
+
+			changed |= ImGui::DragInt(label.c_str(), &date, speed, min, max, "%d", ImGuiSliderFlags_ClampOnInput);
+			if (!changed) return false;
+
+			value = DateType{ static_cast<IntType>(date) };
+			return true;
+		}
+
+		template <typename TimeType>
+		bool DragTime(const std::string& label, TimeType& value, const int min, const int max, const float speed = 0.25f)
+		{
+			int time = static_cast<int>(std::chrono::duration_cast<TimeType>(value).count());
+
+			bool changed = false;
+			if (min != 0 && max != 0) changed |= ClampValue(time, min, max);
+
+			changed |= ImGui::DragInt(label.c_str(), &time, speed, min, max, "%d", ImGuiSliderFlags_ClampOnInput);
+			if (!changed) return false;
+
+			value = TimeType{ static_cast<unsigned int>(time) };
+			return true;
+		}
+
+		bool DragDate(const std::string& label, year_month_day& value, const float speed = 0.25f)
+		{
+			ImGui::Text("%s", label.c_str());
+			const float drag_width = ImGui::GetContentRegionAvail().x / 3.0f;
+
+			bool changed = false;
+			year year = value.year();
+			ImGui::SetNextItemWidth(drag_width);
+			changed |= DragDate<int>("##Year", year, 0, 0, speed);
+			ImGui::SameLine();
+
+			month month = value.month();
+			ImGui::SetNextItemWidth(drag_width);
+			changed |= DragDate<unsigned int>("##Month", month, 1, 12, speed);
+			ImGui::SameLine();
+
+			const unsigned int max_day_count = static_cast<unsigned int>(year_month_day_last{ year / month / last }.day());
+			day day = value.day();
+			ImGui::SetNextItemWidth(drag_width);
+			changed |= DragDate<unsigned int>("##Day", day, 1, static_cast<int>(max_day_count), speed);
+
+			if (!changed) return false;
+
+			value = year / month / day;
+			return true;
+		}
+
+		bool DragTime(const std::string& label, hh_mm_ss<seconds>& value, const float speed = 0.25f)
+		{
+			ImGui::Text("%s", label.c_str());
+			const float drag_width = ImGui::GetContentRegionAvail().x / 3.0f;
+
+			bool changed = false;
+			hours hour = value.hours();
+			ImGui::SetNextItemWidth(drag_width);
+			changed |= DragTime("##Hour", hour, 0, 23, speed);
+			ImGui::SameLine();
+
+			minutes minute = value.minutes();
+			ImGui::SetNextItemWidth(drag_width);
+			changed |= DragTime("##Minute", minute, 0, 59, speed);
+			ImGui::SameLine();
+
+			seconds second = value.seconds();
+			ImGui::SetNextItemWidth(drag_width);
+			changed |= DragTime("##Second", second, 0, 59, speed);
+
+			if (!changed) return false;
+
+			value = hh_mm_ss{ hour + minute + second };
+			return true;
+		}
+	}
+
+	void Image::UI()
+	{
+		if (ImGui::DragInt2("Size", &size.x, 0.25f)) size = { std::max<int>(0, size.x), std::max<int>(0, size.y) };
+		ImGui::SameLine();
+		if (ImGui::Button("Reset")) size = file_path.empty() ? SDL_Point{ width, height } : file_resolution;
+
+		ImVec4 temp_color = ImGui::ColorConvertU32ToFloat4(color);
+		if (ImGui::ColorEdit4("Color", &temp_color.x)) SetColor(ImGui::ColorConvertFloat4ToU32(temp_color));
+
+		if (file_path.empty()) return;
+
+		const bool settings_changed = ResizeSettingsUI(resize_settings);
+
+		// Stretching on the GPU is only a preview, once the size stops changing the file gets resampled properly
+		const bool size_changed = size.x != width || size.y != height;
+		if (settings_changed || (size_changed && !ImGui::IsAnyItemActive() && !IsLoading())) Resample();
+	}
+
+	bool ResizeSettingsUI(ImageResize::Settings& settings)
+	{
+		bool changed = false;
+
+		int quality = static_cast<int>(settings.quality);
+		if (ImGui::Combo("Resampling", &quality, ImageResize::QUALITY_NAMES.data(), static_cast<int>(ImageResize::QUALITY_NAMES.size())))
+		{
+			settings.quality = static_cast<ImageResize::Quality>(quality);
+			changed = true;
+		}
+
+		changed |= ImGui::Checkbox("sRGB correct", &settings.srgb);
+		ImGui::SameLine();
+		changed |= ImGui::Checkbox("Premultiplied alpha", &settings.premultiply_alpha);
+
+		return changed;
+	}
+
+	void Text::UI()
+	{
+		UISettings();
+
+		ImGui::Text("Text:");
+		if (ImGui::InputTextMultiline("##", &text, ImGui::GetContentRegionAvail())) CreateTextTexture();
+	}
+
+	void Text::UIFontSelect()
+	{
+		static std::vector<Fonts::FontPath> available_fonts;
+		if (ImGui::BeginCombo("Font", font->GetPath().GetName().c_str()))
+		{
+			if (available_fonts.empty()) available_fonts = Fonts::AvailableFonts();
+
+			if (ImSearch::BeginSearch())
+			{
+				ImSearch::SearchBar();
+
+				for (const auto& available_font : available_fonts)
+				{
+					ImSearch::SearchableItem(available_font.GetName().c_str(),
+						[this, &available_font](const char* name)
+						{
+							if (ImGui::Selectable(name)) SetFont(GetFont(available_font));
+						}
+					);
+				}
+
+				ImSearch::EndSearch();
+			}
+			ImGui::EndCombo();
+		}
+		else if (!available_fonts.empty()) available_fonts.clear();
+	}
+
+	void Text::UISettings()
+	{
+		UIFontSelect();
+
+		ImVec4 temp_color = ImGui::ColorConvertU32ToFloat4(text_color);
+		if (ImGui::ColorEdit4("Color", &temp_color.x)) SetTextColor(ImGui::ColorConvertFloat4ToU32(temp_color));
+
+		ImVec4 temp_bg_color = ImGui::ColorConvertU32ToFloat4(bg_color);
+		if (ImGui::ColorEdit4("Background color", &temp_bg_color.x)) SetBgColor(ImGui::ColorConvertFloat4ToU32(temp_bg_color));
+
+		if (ImGui::DragFloat("Scale", &line_height, 1.0f, 1.0f, std::numeric_limits<float>::max())) CreateTextTexture();
+
+		ImGui::Separator();
+	}
+
+	void DateTimeText::UI()
+	{
+		UISettings();
+
+		bool changed = false;
+		changed |= UITimezoneSelector();
+
+		if (ImGui::InputText("Formatting", &text)) CreateTextTexture();
+		ImGui::SameLine();
+
+		static bool show_format_window = false;
+		ImGui::TextDisabled("(?)");
+		if (ImGui::IsItemClicked()) show_format_window = true;
+
+		if (show_format_window) UIFormatWindow(show_format_window);
+
+		changed |= ImGui::Checkbox("LowerCase AM/PM", &lower_am_pm);
+
+		ImGui::Separator();
+
+		if (ImGui::Checkbox("Live", &live)) SetLive(live);
+
+		// A live clock sets its own time every second
+		ImGui::BeginDisabled(live);
+
+		if (ImGui::Button("Set current time"))
+		{
+			date_time.MakeCurrentDateTime();
+			changed = true;
+		}
+
+		year_month_day date = date_time.GetDate();
+		changed |= DragDate("Date", date);
+
+		hh_mm_ss time = date_time.GetTime();
+		changed |= DragTime("Time", time);
+
+		ImGui::EndDisabled();
+
+		if (changed)
+		{
+			if (!live) date_time = { date, time };
+			CreateTextTexture();
+		}
+	}
+
+	bool DateTimeText::UITimezoneSelector()
+	{
+		bool changed = false;
+
+		for (size_t i = 0; i < timezones.size(); i++)
+		{
+			ImGui::PushID(static_cast<int>(i));
+
+			const std::string_view& timezone = timezones.at(i);
+
+			ImGui::BeginDisabled(i == 0);
+			if (ImGui::SmallButton("-"))
+			{
+				std::swap(timezones.at(i - 1), timezones.at(i));
+				changed = true;
+			}
+			ImGui::EndDisabled();
+
+			ImGui::SameLine();
+
+			ImGui::BeginDisabled(i == timezones.size() - 1);
+			if (ImGui::SmallButton("+"))
+			{
+				std::swap(timezones.at(i), timezones.at(i + 1));
+				changed = true;
+			}
+			ImGui::EndDisabled();
+
+			ImGui::SameLine();
+
+			ImGui::Text("%s", timezone.data());
+			ImGui::SameLine();
+			if (ImGui::SmallButton("Remove"))
+			{
+				timezones.erase(timezones.begin() + static_cast<int64_t>(i));
+				--i;
+
+				changed = true;
+			}
+			ImGui::PopID();
+		}
+
+		static std::string_view selected_timezone;
+		if (ImGui::BeginCombo("Timezone", selected_timezone.data()))
+		{
+			if (ImSearch::BeginSearch())
+			{
+				ImSearch::SearchBar();
+
+				const auto& timezone_database = get_tzdb();
+				const auto& available_timezones = timezone_database.zones;
+
+				for (const auto& timezone : available_timezones)
+				{
+					const std::string_view timezone_name = timezone.name();
+					if (std::ranges::find(timezones, timezone_name) != timezones.end()) continue;
+
+					ImSearch::SearchableItem(timezone_name.data(),
+						[timezone_name](const char* name)
+						{
+							if (ImGui::Selectable(name))
+							{
+								selected_timezone = timezone_name;
+							}
+						});
+				}
+
+				ImSearch::EndSearch();
+			}
+			ImGui::EndCombo();
+		}
+
+		ImGui::SameLine();
+
+		ImGui::BeginDisabled(selected_timezone.empty());
+		if (ImGui::SmallButton("+"))
+		{
+			timezones.push_back(selected_timezone);
+			selected_timezone = {};
+			changed = true;
+		}
+		ImGui::EndDisabled();
+
+		return changed;
+	}
+
+	void DateTimeText::UIFormatWindow(bool& show_format_window) const
+	{
+		if (ImGui::Begin("Formats", &show_format_window))
+		{
+			if (ImGui::BeginTable("Formats", 3, ImGuiTableFlags_Resizable | ImGuiTableFlags_Borders))
+			{
+				ImGui::TableSetupColumn("Format");
+				ImGui::TableSetupColumn("Result");
+				ImGui::TableSetupColumn("Description");
+				ImGui::TableHeadersRow();
+
+				const zoned_time zoned_time = date_time.GetZonedTime();
+				for (const auto& formatter : DateTime::date_time_formatters)
+				{
+					ImGui::TableNextRow();
+
+					ImGui::TableSetColumnIndex(0);
+					ImGui::Text("%s", formatter.custom_format.data());
+
+					ImGui::TableSetColumnIndex(1);
+					ImGui::PushID(formatter.custom_format.data());
+
+					std::string formatted_date_time{ formatter.replacement_format };
+					formatted_date_time = std::vformat("{:" + formatted_date_time += '}', std::make_format_args(zoned_time));
+					ImGui::Text("%s", formatted_date_time.c_str());
+
+					ImGui::PopID();
+
+					ImGui::TableSetColumnIndex(2);
+					ImGui::Text("%s", formatter.description.data());
+
+				}
+
+				ImGui::TableNextRow();
+
+				ImGui::TableSetColumnIndex(0);
+				ImGui::Text("TMZCITY");
+
+				ImGui::TableSetColumnIndex(1);
+				ImGui::Text("%s", current_zone()->name().data());
+
+				ImGui::TableSetColumnIndex(2);
+				ImGui::Text("The time zone's city name");
+
+				ImGui::EndTable();
+			}
+		}
+		ImGui::End();
+	}
+
+	void Canvas::UpdateScaleAndOffset(const SDL_FPoint& working_area, const float menu_bar_height)
+	{
+		float canvas_height = static_cast<float>(image.GetHeight());
+		base_scale = working_area.y / canvas_height;
+
+		const float scale = Renderer::zoom * base_scale;
+		const float canvas_width = static_cast<float>(image.GetWidth()) * scale;
+		canvas_height *= scale;
+
+		content_size = working_area + ImVec2{ std::max<float>(canvas_width, working_area.x), std::max<float>(canvas_height, working_area.y) };
+
+		render_offset = content_size / 2.0f - ImVec2{ canvas_width, canvas_height } / 2.0f;
+		render_offset.y += menu_bar_height;
+	}
+}
@@ -0,0 +1,469 @@
+#include "Json.hpp"
+
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <iostream>
+
+#include "MappedFile.hpp"
+
+namespace Json
+{
+	namespace
+	{
+		// Deeper than any layout needs, but stops a malicious job line from overflowing the stack
+		constexpr int MAX_DEPTH{ 128 };
+
+		const Value NULL_VALUE;
+		const std::string EMPTY_STRING;
+		const Array EMPTY_ARRAY;
+		const Object EMPTY_OBJECT;
+
+		void AppendUtf8(std::string& output, const uint32_t codepoint)
+		{
+			if (codepoint < 0x80)
+			{
+				output += static_cast<char>(codepoint);
+			}
+			else if (codepoint < 0x800)
+			{
+				output += static_cast<char>(0xC0 | codepoint >> 6);
+				output += static_cast<char>(0x80 | (codepoint & 0x3F));
+			}
+			else if (codepoint < 0x10000)
+			{
+				output += static_cast<char>(0xE0 | codepoint >> 12);
+				output += static_cast<char>(0x80 | (codepoint >> 6 & 0x3F));
+				output += static_cast<char>(0x80 | (codepoint & 0x3F));
+			}
+			else
+			{
+				output += static_cast<char>(0xF0 | codepoint >> 18);
+				output += static_cast<char>(0x80 | (codepoint >> 12 & 0x3F));
+				output += static_cast<char>(0x80 | (codepoint >> 6 & 0x3F));
+				output += static_cast<char>(0x80 | (codepoint & 0x3F));
+			}
+		}
+
+		class Parser
+		{
+		public:
+			explicit Parser(const std::string_view text) : text{ text } {}
+
+			std::optional<Value> ParseDocument()
+			{
+				std::optional<Value> value = ParseValue(0);
+				if (!value) return std::nullopt;
+
+				SkipWhitespace();
+				if (position != text.size()) return Fail("unexpected characters after the value");
+
+				return value;
+			}
+
+		private:
+			std::nullopt_t Fail(const char* message) const
+			{
+				std::cout << "Failed to parse JSON: " << message << " at offset " << position << '\n';
+				return std::nullopt;
+			}
+
+			void SkipWhitespace()
+			{
+				while (position < text.size() && (text[position] == ' ' || text[position] == '\t' || text[position] == '\n' || text[position] == '\r')) position++;
+			}
+
+			bool Consume(const std::string_view expected)
+			{
+				if (text.substr(position, expected.size()) != expected) return false;
+
+				position += expected.size();
+				return true;
+			}
+
+			std::optional<Value> ParseValue(const int depth)
+			{
+				if (depth > MAX_DEPTH) return Fail("nested too deep");
+
+				SkipWhitespace();
+				if (position == text.size()) return Fail("unexpected end");
+
+				switch (text[position])
+				{
+				case '{':
+					return ParseObject(depth);
+
+				case '[':
+					return ParseArray(depth);
+
+				case '"':
+				{
+					std::optional<std::string> string = ParseString();
+					if (!string) return std::nullopt;
+					return Value{ std::move(*string) };
+				}
+
+				case 't':
+					if (Consume("true")) return Value{ true };
+					break;
+
+				case 'f':
+					if (Consume("false")) return Value{ false };
+					break;
+
+				case 'n':
+					if (Consume("null")) return Value{};
+					break;
+
+				default:
+					return ParseNumber();
+				}
+
+				return Fail("unknown literal");
+			}
+
+			std::optional<Value> ParseObject(const int depth)
+			{
+				position++;
+
+				Object object;
+				SkipWhitespace();
+				if (Consume("}")) return Value{ std::move(object) };
+
+				while (true)
+				{
+					SkipWhitespace();
+					if (position == text.size() || text[position] != '"') return Fail("expected a key");
+
+					std::optional<std::string> key = ParseString();
+					if (!key) return std::nullopt;
+
+					SkipWhitespace();
+					if (!Consume(":")) return Fail("expected ':'");
+
+					std::optional<Value> value = ParseValue(depth + 1);
+					if (!value) return std::nullopt;
+
+					object.insert_or_assign(std::move(*key), std::move(*value));
+
+					SkipWhitespace();
+					if (Consume("}")) return Value{ std::move(object) };
+					if (!Consume(",")) return Fail("expected ',' or '}'");
+				}
+			}
+
+			std::optional<Value> ParseArray(const int depth)
+			{
+				position++;
+
+				Array array;
+				SkipWhitespace();
+				if (Consume("]")) return Value{ std::move(array) };
+
+				while (true)
+				{
+					std::optional<Value> value = ParseValue(depth + 1);
+					if (!value) return std::nullopt;
+
+					array.push_back(std::move(*value));
+
+					SkipWhitespace();
+					if (Consume("]")) return Value{ std::move(array) };
+					if (!Consume(",")) return Fail("expected ',' or ']'");
+				}
+			}
+
+			std::optional<uint32_t> ParseHex()
+			{
+				uint32_t result = 0;
+				const char* start = text.data() + position;
+				if (text.size() - position < 4 || std::from_chars(start, start + 4, result, 16).ptr != start + 4) return Fail("invalid unicode escape");
+
+				position += 4;
+				return result;
+			}
+
+			std::optional<std::string> ParseString()
+			{
+				position++;
+
+				std::string string;
+				while (true)
+				{
+					if (position == text.size()) return Fail("unterminated string");
+
+					const char character = text[position++];
+					if (character == '"') return string;
+					if (static_cast<unsigned char>(character) < 0x20) return Fail("control character in string");
+
+					if (character != '\\')
+					{
+						string += character;
+						continue;
+					}
+
+					if (position == text.size()) return Fail("unterminated string");
+
+					switch (text[position++])
+					{
+					case '"': string += '"'; break;
+					case '\\': string += '\\'; break;
+					case '/': string += '/'; break;
+					case 'b': string += '\b'; break;
+					case 'f': string += '\f'; break;
+					case 'n': string += '\n'; break;
+					case 'r': string += '\r'; break;
+					case 't': string += '\t'; break;
+
+					case 'u':
+					{
+						std::optional<uint32_t> codepoint = ParseHex();
+						if (!codepoint) return std::nullopt;
+
+						// Characters outside the basic plane come as a surrogate pair
+						if (*codepoint >= 0xD800 && *codepoint < 0xDC00)
+						{
+							if (!Consume("\\u")) return Fail("unpaired surrogate");
+
+							const std::optional<uint32_t> low = ParseHex();
+							if (!low) return std::nullopt;
+							if (*low < 0xDC00 || *low >= 0xE000) return Fail("unpaired surrogate");
+
+							*codepoint = 0x10000 + ((*codepoint - 0xD800) << 10) + (*low - 0xDC00);
+						}
+
+						AppendUtf8(string, *codepoint);
+						break;
+					}
+
+					default:
+						return Fail("unknown escape");
+					}
+				}
+			}
+
+			std::optional<Value> ParseNumber()
+			{
+				const size_t start = position;
+				while (position < text.size() && std::string_view{ "+-0123456789.eE" }.find(text[position]) != std::string_view::npos) position++;
+
+				double number = 0.0;
+				const auto [end, error] = std::from_chars(text.data() + start, text.data() + position, number);
+				if (start == position || error != std::errc{} || end != text.data() + position)
+				{
+					position = start;
+					return Fail("invalid number");
+				}
+
+				return Value{ number };
+			}
+
+			std::string_view text;
+			size_t position{ 0 };
+		};
+
+		void WriteString(std::string& output, const std::string& string)
+		{
+			output += '"';
+			for (const char character : string)
+			{
+				switch (character)
+				{
+				case '"': output += "\\\""; break;
+				case '\\': output += "\\\\"; break;
+				case '\n': output += "\\n"; break;
+				case '\r': output += "\\r"; break;
+				case '\t': output += "\\t"; break;
+
+				default:
+					if (static_cast<unsigned char>(character) < 0x20)
+					{
+						constexpr std::string_view HEX_DIGITS{ "0123456789abcdef" };
+						output += "\\u00";
+						output += HEX_DIGITS[static_cast<unsigned char>(character) >> 4];
+						output += HEX_DIGITS[character & 0xF];
+					}
+					else output += character;
+					break;
+				}
+			}
+			output += '"';
+		}
+
+		void WriteValue(std::string& output, const Value& value, const bool pretty, const int depth)
+		{
+			const auto new_line = [&output, pretty](const int indent)
+				{
+					if (!pretty) return;
+
+					output += '\n';
+					output.append(static_cast<size_t>(indent), '\t');
+				};
+
+			if (value.IsBool())
+			{
+				output += value.GetBool() ? "true" : "false";
+			}
+			else if (value.IsNumber())
+			{
+				const double number = value.GetNumber();
+				if (!std::isfinite(number))
+				{
+					output += "null";
+					return;
+				}
+
+				std::array<char, 32> buffer{};
+				const auto [end, error] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), number);
+				output.append(buffer.data(), end);
+			}
+			else if (value.IsString())
+			{
+				WriteString(output, value.GetString());
+			}
+			else if (value.IsArray())
+			{
+				const Array& array = value.GetArray();
+				output += '[';
+				for (size_t i = 0; i < array.size(); i++)
+				{
+					if (i > 0) output += ',';
+					new_line(depth + 1);
+					WriteValue(output, array.at(i), pretty, depth + 1);
+				}
+				if (!array.empty()) new_line(depth);
+				output += ']';
+			}
+			else if (value.IsObject())
+			{
+				const Object& object = value.GetObject();
+				output += '{';
+				bool first = true;
+				for (const auto& [key, member] : object)
+				{
+					if (!first) output += ',';
+					first = false;
+
+					new_line(depth + 1);
+					WriteString(output, key);
+					output += pretty ? ": " : ":";
+					WriteValue(output, member, pretty, depth + 1);
+				}
+				if (!object.empty()) new_line(depth);
+				output += '}';
+			}
+			else
+			{
+				output += "null";
+			}
+		}
+	}
+
+	bool Value::GetBool(const bool fallback) const
+	{
+		const bool* boolean = std::get_if<bool>(&value);
+		return boolean != nullptr ? *boolean : fallback;
+	}
+
+	double Value::GetNumber(const double fallback) const
+	{
+		const double* number = std::get_if<double>(&value);
+		return number != nullptr ? *number : fallback;
+	}
+
+	int Value::GetInt(const int fallback) const
+	{
+		const double* number = std::get_if<double>(&value);
+		return number != nullptr && std::isfinite(*number) ? static_cast<int>(std::lround(*number)) : fallback;
+	}
+
+	const std::string& Value::GetString() const
+	{
+		const std::string* string = std::get_if<std::string>(&value);
+		return string != nullptr ? *string : EMPTY_STRING;
+	}
+
+	const Array& Value::GetArray() const
+	{
+		const Array* array = std::get_if<Array>(&value);
+		return array != nullptr ? *array : EMPTY_ARRAY;
+	}
+
+	const Object& Value::GetObject() const
+	{
+		const Object* object = std::get_if<Object>(&value);
+		return object != nullptr ? *object : EMPTY_OBJECT;
+	}
+
+	const Value& Value::operator[](const std::string_view key) const
+	{
+		const Object& object = GetObject();
+		const auto found = object.find(key);
+		return found != object.end() ? found->second : NULL_VALUE;
+	}
+
+	bool Value::Has(const std::string_view key) const
+	{
+		return GetObject().contains(key);
+	}
+
+	void Value::Set(const std::string& key, Value member)
+	{
+		if (!IsObject()) value = Object{};
+		std::get<Object>(value).insert_or_assign(key, std::move(member));
+	}
+
+	void Value::Erase(const std::string_view key)
+	{
+		Object* object = std::get_if<Object>(&value);
+		if (object == nullptr) return;
+
+		const auto found = object->find(key);
+		if (found != object->end()) object->erase(found);
+	}
+
+	Value* Value::Find(const std::string_view key)
+	{
+		Object* object = std::get_if<Object>(&value);
+		if (object == nullptr) return nullptr;
+
+		const auto found = object->find(key);
+		return found != object->end() ? &found->second : nullptr;
+	}
+
+	Array* Value::GetMutableArray()
+	{
+		return std::get_if<Array>(&value);
+	}
+
+	bool Value::operator==(const Value& other) const
+	{
+		return value == other.value;
+	}
+
+	std::optional<Value> Parse(const std::string_view text)
+	{
+		return Parser{ text }.ParseDocument();
+	}
+
+	std::optional<Value> ReadFile(const std::filesystem::path& path)
+	{
+		const File::MappedFile file{ path };
+		if (!file.IsValid())
+		{
+			std::cout << "Failed to open JSON file: " << path.string() << '\n';
+			return std::nullopt;
+		}
+
+		return Parse({ reinterpret_cast<const char*>(file.GetData()), file.GetSize() });
+	}
+
+	std::string Write(const Value& value, const bool pretty)
+	{
+		std::string output;
+		WriteValue(output, value, pretty, 0);
+		if (pretty) output += '\n';
+
+		return output;
+	}
+}
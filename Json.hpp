@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+// Just enough JSON for layouts and render jobs. Numbers are always doubles and objects keep their keys sorted
+namespace Json
+{
+	class Value;
+
+	using Array = std::vector<Value>;
+	using Object = std::map<std::string, Value, std::less<>>;
+
+	class Value
+	{
+	public:
+		Value() = default;
+		Value(std::nullptr_t) {}
+		Value(const bool boolean) : value{ boolean } {}
+		Value(const double number) : value{ number } {}
+		Value(const int number) : value{ static_cast<double>(number) } {}
+		Value(const uint32_t number) : value{ static_cast<double>(number) } {}
+		Value(const float number) : value{ static_cast<double>(number) } {}
+		Value(std::string string) : value{ std::move(string) } {}
+		Value(const char* string) : value{ std::string{ string } } {}
+		Value(Array array) : value{ std::move(array) } {}
+		Value(Object object) : value{ std::move(object) } {}
+
+		[[nodiscard]] bool IsNull() const { return std::holds_alternative<std::nullptr_t>(value); }
+		[[nodiscard]] bool IsBool() const { return std::holds_alternative<bool>(value); }
+		[[nodiscard]] bool IsNumber() const { return std::holds_alternative<double>(value); }
+		[[nodiscard]] bool IsString() const { return std::holds_alternative<std::string>(value); }
+		[[nodiscard]] bool IsArray() const { return std::holds_alternative<Array>(value); }
+		[[nodiscard]] bool IsObject() const { return std::holds_alternative<Object>(value); }
+
+		// These return the fallback (or an empty one) when the value has a different type, so missing fields can just be read
+		[[nodiscard]] bool GetBool(bool fallback = false) const;
+		[[nodiscard]] double GetNumber(double fallback = 0.0) const;
+		[[nodiscard]] int GetInt(int fallback = 0) const;
+		[[nodiscard]] const std::string& GetString() const;
+		[[nodiscard]] const Array& GetArray() const;
+		[[nodiscard]] const Object& GetObject() const;
+
+		// Null when this isn't an object or doesn't have the key
+		[[nodiscard]] const Value& operator[](std::string_view key) const;
+		[[nodiscard]] bool Has(std::string_view key) const;
+
+		// Turns this into an object first if it isn't one yet
+		void Set(const std::string& key, Value member);
+		void Erase(std::string_view key);
+
+		// For changing values in place, nullptr when the type doesn't match or the key is missing
+		[[nodiscard]] Value* Find(std::string_view key);
+		[[nodiscard]] Array* GetMutableArray();
+
+		// Deep comparison, numbers compare exactly
+		[[nodiscard]] bool operator==(const Value& other) const;
+
+	private:
+		std::variant<std::nullptr_t, bool, double, std::string, Array, Object> value;
+	};
+
+	// Prints what went wrong and where when the text isn't valid JSON
+	[[nodiscard]] std::optional<Value> Parse(std::string_view text);
+	[[nodiscard]] std::optional<Value> ReadFile(const std::filesystem::path& path);
+
+	// Pretty printing uses tabs, otherwise everything ends up on a single line (like JSON lines wants it)
+	[[nodiscard]] std::string Write(const Value& value, bool pretty = true);
+}
@@ -0,0 +1,116 @@
+#include "LayerGrid.hpp"
+
+#include <algorithm>
+
+namespace Image
+{
+	namespace
+	{
+		// At most this many cells along the longest side of the canvas, a 64 x 64 grid is still small enough to rebuild every frame of a drag
+		constexpr int MAX_CELLS_PER_SIDE{ 64 };
+
+		// Smaller cells would mostly just put the same layer in more of them
+		constexpr int MIN_CELL_SIZE{ 64 };
+	}
+
+	void LayerGrid::Build(const std::span<const SDL_Rect> rects, const int canvas_width, const int canvas_height)
+	{
+		cell_size = std::max<int>(MIN_CELL_SIZE, (std::max<int>(canvas_width, canvas_height) + MAX_CELLS_PER_SIDE - 1) / MAX_CELLS_PER_SIDE);
+		columns = std::max<int>((canvas_width + cell_size - 1) / cell_size, 1);
+		rows = std::max<int>((canvas_height + cell_size - 1) / cell_size, 1);
+
+		// Counted first, so every cell gets exactly as much room in cell_layers as it needs
+		cell_starts.assign(static_cast<size_t>(columns) * static_cast<size_t>(rows) + 1, 0);
+		for (const SDL_Rect& rect : rects)
+		{
+			if (SDL_RectEmpty(&rect)) continue;
+
+			const CellRange range = GetCellRange(rect);
+			for (int row = range.first_row; row <= range.last_row; row++)
+			{
+				for (int column = range.first_column; column <= range.last_column; column++) cell_starts.at(static_cast<size_t>(row * columns + column) + 1)++;
+			}
+		}
+
+		for (size_t i = 1; i < cell_starts.size(); i++) cell_starts.at(i) += cell_starts.at(i - 1);
+
+		// Going through the layers in order keeps every cell sorted from bottom to top
+		cell_layers.resize(cell_starts.back());
+		std::vector<uint32_t> cell_ends(cell_starts.begin(), cell_starts.end() - 1);
+		for (size_t i = 0; i < rects.size(); i++)
+		{
+			const SDL_Rect& rect = rects[i];
+			if (SDL_RectEmpty(&rect)) continue;
+
+			const CellRange range = GetCellRange(rect);
+			for (int row = range.first_row; row <= range.last_row; row++)
+			{
+				for (int column = range.first_column; column <= range.last_column; column++) cell_layers.at(cell_ends.at(static_cast<size_t>(row * columns + column))++) = static_cast<uint32_t>(i);
+			}
+		}
+	}
+
+	void LayerGrid::Clear()
+	{
+		cell_size = 0;
+		columns = 0;
+		rows = 0;
+		cell_starts.clear();
+		cell_layers.clear();
+	}
+
+	std::optional<size_t> LayerGrid::FindTopmost(const std::span<const SDL_Rect> rects, const SDL_FPoint& point, const std::function<bool(size_t)>& accept) const
+	{
+		if (cell_starts.empty()) return std::nullopt;
+
+		const int column = std::clamp<int>(static_cast<int>(std::max<float>(point.x, 0.0f)) / cell_size, 0, columns - 1);
+		const int row = std::clamp<int>(static_cast<int>(std::max<float>(point.y, 0.0f)) / cell_size, 0, rows - 1);
+		const size_t cell = static_cast<size_t>(row * columns + column);
+
+		for (uint32_t i = cell_starts.at(cell + 1); i > cell_starts.at(cell); i--)
+		{
+			const uint32_t layer = cell_layers.at(i - 1);
+			const SDL_Rect& rect = rects[layer];
+
+			// Right and bottom edges belong to the next pixel, like they do for the cells
+			const bool inside = point.x >= static_cast<float>(rect.x) && point.x < static_cast<float>(rect.x + rect.w) &&
+				point.y >= static_cast<float>(rect.y) && point.y < static_cast<float>(rect.y + rect.h);
+			if (inside && (!accept || accept(layer))) return layer;
+		}
+
+		return std::nullopt;
+	}
+
+	void LayerGrid::FindOverlapping(const std::span<const SDL_Rect> rects, const SDL_Rect& rect, std::vector<size_t>& result) const
+	{
+		result.clear();
+		if (cell_starts.empty() || SDL_RectEmpty(&rect)) return;
+
+		const CellRange range = GetCellRange(rect);
+		for (int row = range.first_row; row <= range.last_row; row++)
+		{
+			for (int column = range.first_column; column <= range.last_column; column++)
+			{
+				const size_t cell = static_cast<size_t>(row * columns + column);
+				for (uint32_t i = cell_starts.at(cell); i < cell_starts.at(cell + 1); i++)
+				{
+					const uint32_t layer = cell_layers.at(i);
+					if (SDL_HasRectIntersection(&rects[layer], &rect)) result.push_back(layer);
+				}
+			}
+		}
+
+		// Layers spanning several cells were found once for each of them
+		std::ranges::sort(result);
+		const auto duplicates = std::ranges::unique(result);
+		result.erase(duplicates.begin(), duplicates.end());
+	}
+
+	LayerGrid::CellRange LayerGrid::GetCellRange(const SDL_Rect& rect) const
+	{
+		// Anything left of or above the canvas is in the first cells, anything right of or below it in the last ones
+		const auto to_cell = [this](const int position, const int count) { return std::clamp<int>(std::max<int>(position, 0) / cell_size, 0, count - 1); };
+
+		return { to_cell(rect.x, columns), to_cell(rect.y, rows), to_cell(rect.x + rect.w - 1, columns), to_cell(rect.y + rect.h - 1, rows) };
+	}
+}
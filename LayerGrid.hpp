@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <SDL3/SDL_rect.h>
+
+namespace Image
+{
+	// A uniform grid over the canvas where every cell lists the layers overlapping it, from bottom to top.
+	// Finding the layers at a point or in a rect only goes through the ones in those cells, so a banner with thousands of small layers
+	// (like one for every name on a wall of names) picks and redraws about as fast as one with a few.
+	// The rects aren't kept here, queries take the same ones Build got
+	class LayerGrid
+	{
+	public:
+		// Rects that are (partly) off the canvas are also put in the cells along its edges, empty ones are left out
+		void Build(std::span<const SDL_Rect> rects, int canvas_width, int canvas_height);
+		void Clear();
+
+		// Index of the topmost rect containing point (in canvas pixels). When given, rects also have to pass accept, like for checking the pixels inside them
+		[[nodiscard]] std::optional<size_t> FindTopmost(std::span<const SDL_Rect> rects, const SDL_FPoint& point, const std::function<bool(size_t)>& accept = {}) const;
+
+		// Indices of the rects overlapping rect, from bottom to top. Clears result first
+		void FindOverlapping(std::span<const SDL_Rect> rects, const SDL_Rect& rect, std::vector<size_t>& result) const;
+
+	private:
+		// Inclusive, clamped to the grid
+		struct CellRange
+		{
+			int first_column{ 0 };
+			int first_row{ 0 };
+			int last_column{ 0 };
+			int last_row{ 0 };
+		};
+
+		[[nodiscard]] CellRange GetCellRange(const SDL_Rect& rect) const;
+
+		int cell_size{ 0 };
+		int columns{ 0 };
+		int rows{ 0 };
+
+		// The layers of cell i are cell_layers[cell_starts[i]] up to cell_layers[cell_starts[i + 1]], one array for all cells keeps building cheap
+		std::vector<uint32_t> cell_starts;
+		std::vector<uint32_t> cell_layers;
+	};
+}
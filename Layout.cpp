@@ -0,0 +1,380 @@
+#include "Layout.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <format>
+#include <iostream>
+#include <unordered_map>
+
+#include "Image.hpp"
+#include "MappedFile.hpp"
+#include "Renderer.hpp"
+
+using namespace std::chrono;
+
+namespace Layout
+{
+	namespace
+	{
+		constexpr const char* IMAGE_TYPE{ "image" };
+		constexpr const char* TEXT_TYPE{ "text" };
+		constexpr const char* DATE_TIME_TYPE{ "date_time" };
+
+		// Written as "#RRGGBBAA", that's how people write colors by hand
+		Json::Value WriteColor(const uint32_t color)
+		{
+			return std::format("#{:02X}{:02X}{:02X}{:02X}", color & 0xFF, (color >> 8) & 0xFF, (color >> 16) & 0xFF, color >> 24);
+		}
+
+		uint32_t ReadColor(const Json::Value& value, const uint32_t fallback)
+		{
+			const std::string& string = value.GetString();
+			if (string.size() != 9 || string.front() != '#') return fallback;
+
+			uint32_t rgba = 0;
+			const auto [end, error] = std::from_chars(string.data() + 1, string.data() + string.size(), rgba, 16);
+			if (error != std::errc{} || end != string.data() + string.size()) return fallback;
+
+			return (rgba >> 24) | ((rgba >> 8) & 0xFF00) | ((rgba << 8) & 0xFF0000) | (rgba << 24);
+		}
+
+		Json::Value WriteResizeSettings(const ImageResize::Settings& settings)
+		{
+			Json::Value value;
+			value.Set("quality", ImageResize::QUALITY_NAMES.at(static_cast<size_t>(settings.quality)));
+			value.Set("srgb", settings.srgb);
+			value.Set("premultiply_alpha", settings.premultiply_alpha);
+			return value;
+		}
+
+		ImageResize::Settings ReadResizeSettings(const Json::Value& value)
+		{
+			ImageResize::Settings settings;
+
+			const std::string& quality = value["quality"].GetString();
+			const auto found = std::ranges::find(ImageResize::QUALITY_NAMES, quality);
+			if (found != ImageResize::QUALITY_NAMES.end()) settings.quality = static_cast<ImageResize::Quality>(found - ImageResize::QUALITY_NAMES.begin());
+
+			settings.srgb = value["srgb"].GetBool(settings.srgb);
+			settings.premultiply_alpha = value["premultiply_alpha"].GetBool(settings.premultiply_alpha);
+			return settings;
+		}
+
+		// Reads numbers split by separator, like "2025-01-31" or "13:30:00"
+		bool ReadNumbers(const std::string& string, const char separator, std::array<int, 3>& numbers)
+		{
+			const char* position = string.data();
+			const char* end = string.data() + string.size();
+
+			for (size_t i = 0; i < numbers.size(); i++)
+			{
+				if (i > 0)
+				{
+					if (position == end || *position != separator) return false;
+					position++;
+				}
+
+				const auto [number_end, error] = std::from_chars(position, end, numbers.at(i));
+				if (error != std::errc{}) return false;
+				position = number_end;
+			}
+
+			return position == end;
+		}
+
+		// Falls back to now when either is missing or invalid, so a layout without them always shows the current time
+		DateTime::DateTime ReadDateTime(const Json::Value& layer)
+		{
+			std::array<int, 3> date{};
+			std::array<int, 3> time{};
+			if (!ReadNumbers(layer["date"].GetString(), '-', date) || !ReadNumbers(layer["time"].GetString(), ':', time)) return {};
+
+			const year_month_day year_month_day{ year{ date.at(0) }, month{ static_cast<unsigned int>(date.at(1)) }, day{ static_cast<unsigned int>(date.at(2)) } };
+			const bool valid_time = time.at(0) >= 0 && time.at(0) < 24 && time.at(1) >= 0 && time.at(1) < 60 && time.at(2) >= 0 && time.at(2) < 60;
+			if (!year_month_day.ok() || !valid_time)
+			{
+				std::cout << "Invalid date or time in layout: " << layer["date"].GetString() << ' ' << layer["time"].GetString() << '\n';
+				return {};
+			}
+
+			return { year_month_day, hh_mm_ss<seconds>{ hours{ time.at(0) } + minutes{ time.at(1) } + seconds{ time.at(2) } } };
+		}
+
+		Json::Value WriteLayer(const Image::Image& image)
+		{
+			Json::Value layer;
+			layer.Set("id", static_cast<double>(image.GetId()));
+			layer.Set("x", image.x);
+			layer.Set("y", image.y);
+			layer.Set("color", WriteColor(image.GetColor()));
+
+			const auto* text = dynamic_cast<const Image::Text*>(&image);
+			if (text == nullptr)
+			{
+				layer.Set("type", IMAGE_TYPE);
+				layer.Set("path", image.GetFilePath());
+				layer.Set("width", image.size.x);
+				layer.Set("height", image.size.y);
+				layer.Set("resize", WriteResizeSettings(image.GetResizeSettings()));
+				return layer;
+			}
+
+			layer.Set("text", text->GetText());
+			layer.Set("font", text->GetFontPath().GetPath().generic_string());
+			layer.Set("text_color", WriteColor(text->GetTextColor()));
+			layer.Set("bg_color", WriteColor(text->GetBgColor()));
+			layer.Set("scale", text->GetScale());
+
+			const auto* date_time_text = dynamic_cast<const Image::DateTimeText*>(text);
+			if (date_time_text == nullptr)
+			{
+				layer.Set("type", TEXT_TYPE);
+				return layer;
+			}
+
+			layer.Set("type", DATE_TIME_TYPE);
+			layer.Set("lower_am_pm", date_time_text->GetLowerAmPm());
+
+			Json::Array zones;
+			for (const std::string_view zone : date_time_text->GetTimezones()) zones.emplace_back(std::string{ zone });
+			layer.Set("zones", std::move(zones));
+
+			// The time of a live clock changes every second, saving it would make every second an undo step
+			layer.Set("live", date_time_text->IsLive());
+			if (date_time_text->IsLive()) return layer;
+
+			const year_month_day date = date_time_text->GetDateTime().GetDate();
+			const hh_mm_ss<seconds> time = date_time_text->GetDateTime().GetTime();
+			layer.Set("date", std::format("{:04}-{:02}-{:02}", static_cast<int>(date.year()), static_cast<unsigned int>(date.month()), static_cast<unsigned int>(date.day())));
+			layer.Set("time", std::format("{:02}:{:02}:{:02}", time.hours().count(), time.minutes().count(), time.seconds().count()));
+			return layer;
+		}
+
+		// Only calls the setters whose values changed, every one of them rasterizes the text again
+		void ApplyTextSettings(Image::Text& text, const Json::Value& layer)
+		{
+			const std::shared_ptr<Fonts::Font> font = Fonts::GetFont(Fonts::FontPath{ layer["font"].GetString() });
+			if (font->GetPath().GetPath() != text.GetFontPath().GetPath()) text.SetFont(font);
+
+			const uint32_t text_color = ReadColor(layer["text_color"], 0xFFFFFFFF);
+			if (text_color != text.GetTextColor()) text.SetTextColor(text_color);
+
+			const uint32_t bg_color = ReadColor(layer["bg_color"], 0x00000000);
+			if (bg_color != text.GetBgColor()) text.SetBgColor(bg_color);
+
+			const float scale = static_cast<float>(layer["scale"].GetNumber(text.GetScale()));
+			if (scale != text.GetScale()) text.SetScale(scale);
+
+			if (layer.Has("text") && layer["text"].GetString() != text.GetText()) text.SetText(layer["text"].GetString());
+		}
+
+		void ApplyDateTimeSettings(Image::DateTimeText& date_time_text, const Json::Value& layer)
+		{
+			if (layer.Has("zones"))
+			{
+				std::vector<std::string> zones;
+				for (const Json::Value& zone : layer["zones"].GetArray()) zones.push_back(zone.GetString());
+
+				if (!std::ranges::equal(zones, date_time_text.GetTimezones())) date_time_text.SetTimezones(zones);
+			}
+
+			const bool lower_am_pm = layer["lower_am_pm"].GetBool(date_time_text.GetLowerAmPm());
+			if (lower_am_pm != date_time_text.GetLowerAmPm()) date_time_text.SetLowerAmPm(lower_am_pm);
+
+			const bool live = layer["live"].GetBool(false);
+			if (live != date_time_text.IsLive()) date_time_text.SetLive(live);
+			if (live) return;
+
+			const DateTime::DateTime date_time = ReadDateTime(layer);
+			if (date_time.GetDate() != date_time_text.GetDateTime().GetDate() || date_time.GetTime().to_duration() != date_time_text.GetDateTime().GetTime().to_duration())
+			{
+				date_time_text.SetDateTime(date_time);
+			}
+		}
+
+		// Reuses existing when it is the same kind of layer (and the same file for images), returns nullptr if the layer can't be made
+		std::unique_ptr<Image::Image> ApplyLayer(const Json::Value& layer, std::unique_ptr<Image::Image> existing)
+		{
+			const std::string& type = layer["type"].GetString();
+			auto* existing_text = dynamic_cast<Image::Text*>(existing.get());
+			auto* existing_date_time_text = dynamic_cast<Image::DateTimeText*>(existing.get());
+
+			if (type == IMAGE_TYPE)
+			{
+				const std::string& path = layer["path"].GetString();
+				const ImageResize::Settings resize_settings = ReadResizeSettings(layer["resize"]);
+				if (existing == nullptr || existing_text != nullptr || existing->GetFilePath() != path || existing->GetResizeSettings() != resize_settings)
+				{
+					existing = std::make_unique<Image::Image>(std::filesystem::path{ path }, 1.0f, resize_settings);
+					if (existing->GetFilePath().empty()) return nullptr;
+				}
+
+				const SDL_Point size{ layer["width"].GetInt(existing->size.x), layer["height"].GetInt(existing->size.y) };
+				if (size.x != existing->size.x || size.y != existing->size.y)
+				{
+					existing->size = size;
+					existing->Resample();
+				}
+			}
+			else if (type == TEXT_TYPE)
+			{
+				if (existing_text == nullptr || existing_date_time_text != nullptr)
+				{
+					auto text = std::make_unique<Image::Text>(layer["text"].GetString(), ReadColor(layer["text_color"], 0xFFFFFFFF));
+					existing_text = text.get();
+					existing = std::move(text);
+				}
+
+				ApplyTextSettings(*existing_text, layer);
+			}
+			else if (type == DATE_TIME_TYPE)
+			{
+				if (existing_date_time_text == nullptr)
+				{
+					auto date_time_text = std::make_unique<Image::DateTimeText>();
+					existing_date_time_text = date_time_text.get();
+					existing = std::move(date_time_text);
+				}
+
+				ApplyTextSettings(*existing_date_time_text, layer);
+				ApplyDateTimeSettings(*existing_date_time_text, layer);
+			}
+			else
+			{
+				std::cout << "Unknown layer type in layout: " << type << '\n';
+				return nullptr;
+			}
+
+			if (const uint64_t id = GetLayerId(layer); id != 0) existing->SetId(id);
+
+			existing->x = layer["x"].GetInt();
+			existing->y = layer["y"].GetInt();
+
+			const uint32_t color = ReadColor(layer["color"], 0xFFFFFFFF);
+			if (color != existing->GetColor()) existing->SetColor(color);
+
+			return existing;
+		}
+
+		bool ApplyCanvas(const Json::Value& canvas_layout)
+		{
+			const std::string& path = canvas_layout["path"].GetString();
+			if (path.empty())
+			{
+				std::cout << "Layout has no canvas image" << '\n';
+				return false;
+			}
+
+			const float scaling = static_cast<float>(canvas_layout["scale"].GetNumber(1.0));
+			const ImageResize::Settings resize_settings = ReadResizeSettings(canvas_layout["resize"]);
+
+			const bool matches = Image::canvas != nullptr && Image::canvas->image.GetFilePath() == path &&
+				Image::canvas->GetScaling() == scaling && Image::canvas->image.GetResizeSettings() == resize_settings;
+			if (!matches)
+			{
+				auto canvas = std::make_unique<Image::Canvas>(std::filesystem::path{ path }, scaling, resize_settings);
+
+				// There's only a render target to check when there is a renderer
+				if (canvas->image.GetFilePath().empty() || (Renderer::GetRenderer() != nullptr && !canvas->IsValid())) return false;
+
+				Image::canvas = std::move(canvas);
+			}
+
+			const uint32_t color = ReadColor(canvas_layout["color"], 0xFFFFFFFF);
+			if (color != Image::canvas->image.GetColor()) Image::canvas->image.SetColor(color);
+
+			return true;
+		}
+	}
+
+	uint64_t GetLayerId(const Json::Value& layer)
+	{
+		const double id = layer["id"].GetNumber();
+		return id >= 1.0 ? static_cast<uint64_t>(id) : 0;
+	}
+
+	Json::Value Capture()
+	{
+		Json::Value layout;
+		layout.Set("version", VERSION);
+
+		if (Image::canvas != nullptr)
+		{
+			const Image::Image& canvas_image = Image::canvas->image;
+
+			Json::Value canvas;
+			canvas.Set("path", canvas_image.GetFilePath());
+			canvas.Set("scale", Image::canvas->GetScaling());
+			canvas.Set("resize", WriteResizeSettings(canvas_image.GetResizeSettings()));
+			canvas.Set("color", WriteColor(canvas_image.GetColor()));
+			layout.Set("canvas", std::move(canvas));
+		}
+
+		Json::Array layers;
+		for (const auto& image : Image::images) layers.push_back(WriteLayer(*image));
+		layout.Set("layers", std::move(layers));
+
+		return layout;
+	}
+
+	bool Apply(const Json::Value& layout)
+	{
+		if (layout["version"].GetInt() > VERSION)
+		{
+			std::cout << "Layout was saved by a newer version: " << layout["version"].GetInt() << '\n';
+			return false;
+		}
+
+		if (!ApplyCanvas(layout["canvas"])) return false;
+
+		const uint64_t selected_id = Image::IsSelectionValid() ? Image::GetSelection()->GetId() : 0;
+
+		// The new layers are made before the old ones are gone, so fonts and cached images they share stay loaded
+		std::vector<std::unique_ptr<Image::Image>> existing_layers = std::move(Image::images);
+		Image::images.clear();
+
+		// Layers are matched by id first, so moving them around doesn't make them load or rasterize again.
+		// Whatever has no match gets the leftover layer at the same index, which is all layouts without ids can do
+		const Json::Array& layer_layouts = layout["layers"].GetArray();
+		std::vector<std::unique_ptr<Image::Image>> matches(layer_layouts.size());
+
+		std::unordered_map<uint64_t, size_t> existing_indices;
+		for (size_t i = 0; i < existing_layers.size(); i++) existing_indices.emplace(existing_layers.at(i)->GetId(), i);
+
+		for (size_t i = 0; i < layer_layouts.size(); i++)
+		{
+			const auto found = existing_indices.find(GetLayerId(layer_layouts.at(i)));
+			if (found != existing_indices.end()) matches.at(i) = std::move(existing_layers.at(found->second));
+		}
+
+		for (size_t i = 0; i < layer_layouts.size() && i < existing_layers.size(); i++)
+		{
+			if (matches.at(i) == nullptr) matches.at(i) = std::move(existing_layers.at(i));
+		}
+
+		std::vector<std::unique_ptr<Image::Image>> layers;
+		layers.reserve(layer_layouts.size());
+
+		for (size_t i = 0; i < layer_layouts.size(); i++)
+		{
+			if (std::unique_ptr<Image::Image> layer = ApplyLayer(layer_layouts.at(i), std::move(matches.at(i)))) layers.push_back(std::move(layer));
+		}
+
+		Image::images = std::move(layers);
+
+		// The selection follows the layer, wherever it ended up
+		Image::ResetSelection();
+		for (size_t i = 0; i < Image::images.size(); i++)
+		{
+			if (selected_id != 0 && Image::images.at(i)->GetId() == selected_id) Image::selection_index = i;
+		}
+
+		return true;
+	}
+
+	bool Save(const std::filesystem::path& path)
+	{
+		const std::string text = Json::Write(Capture());
+		return File::WriteAtomically(path, text.data(), text.size());
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+
+#include "Json.hpp"
+
+// The canvas and its layers as JSON, so a banner can be opened again later or rendered by the command line tool
+namespace Layout
+{
+	// Bumped whenever older versions would read a layout wrong
+	constexpr int VERSION{ 1 };
+
+	[[nodiscard]] Json::Value Capture();
+
+	// 0 for layers saved before they had ids
+	[[nodiscard]] uint64_t GetLayerId(const Json::Value& layer);
+
+	// Replaces the canvas and layers with the ones in the layout. Date time layers without a "date" ("YYYY-MM-DD") and "time" ("HH:MM:SS") show the current time.
+	// Whatever already matches it stays loaded and only gets the settings that differ applied, so applying the same layout again with a few changes doesn't reload any images or fonts
+	bool Apply(const Json::Value& layout);
+
+	bool Save(const std::filesystem::path& path);
+}
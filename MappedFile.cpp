@@ -0,0 +1,125 @@
+#include "MappedFile.hpp"
+
+#include <iostream>
+
+#include <SDL3/SDL_error.h>
+#include <SDL3/SDL_iostream.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace File
+{
+#ifdef _WIN32
+	MappedFile::MappedFile(const std::filesystem::path& path)
+	{
+		file_handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file_handle == INVALID_HANDLE_VALUE)
+		{
+			file_handle = nullptr;
+			std::cout << "Failed to open file for mapping: " << path.generic_string() << '\n';
+			return;
+		}
+
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0) return;
+
+		mapping_handle = CreateFileMappingW(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping_handle == nullptr)
+		{
+			std::cout << "Failed to create file mapping: " << GetLastError() << '\n';
+			return;
+		}
+
+		data = static_cast<const uint8_t*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+		if (data == nullptr)
+		{
+			std::cout << "Failed to map file: " << GetLastError() << '\n';
+			return;
+		}
+
+		size = static_cast<size_t>(file_size.QuadPart);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (data != nullptr) UnmapViewOfFile(data);
+		if (mapping_handle != nullptr) CloseHandle(mapping_handle);
+		if (file_handle != nullptr) CloseHandle(file_handle);
+	}
+#else
+	MappedFile::MappedFile(const std::filesystem::path& path)
+	{
+		const int file_descriptor = open(path.c_str(), O_RDONLY);
+		if (file_descriptor < 0)
+		{
+			std::cout << "Failed to open file for mapping: " << path.generic_string() << '\n';
+			return;
+		}
+
+		struct stat file_stat{};
+		if (fstat(file_descriptor, &file_stat) == 0 && file_stat.st_size > 0)
+		{
+			void* mapping = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+			if (mapping == MAP_FAILED) std::cout << "Failed to map file: " << path.generic_string() << '\n';
+			else
+			{
+				data = static_cast<const uint8_t*>(mapping);
+				size = static_cast<size_t>(file_stat.st_size);
+				madvise(mapping, size, MADV_SEQUENTIAL);
+			}
+		}
+
+		// The mapping keeps the file alive on its own
+		close(file_descriptor);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (data != nullptr) munmap(const_cast<uint8_t*>(data), size);
+	}
+#endif
+
+	bool WriteAtomically(const std::filesystem::path& path, const void* data, const size_t size)
+	{
+		std::filesystem::path temporary_path = path;
+		temporary_path += ".tmp";
+
+		SDL_IOStream* stream = SDL_IOFromFile(temporary_path.string().c_str(), "wb");
+		if (stream == nullptr)
+		{
+			std::cout << "Failed to open file for writing: " << SDL_GetError() << '\n';
+			return false;
+		}
+
+		bool succeeded = SDL_WriteIO(stream, data, size) == size;
+		if (!succeeded) std::cout << "Failed to write file: " << SDL_GetError() << '\n';
+
+		// Closing flushes, so it can fail just the same as writing
+		if (!SDL_CloseIO(stream))
+		{
+			std::cout << "Failed to close file: " << SDL_GetError() << '\n';
+			succeeded = false;
+		}
+
+		std::error_code error;
+		if (succeeded)
+		{
+			std::filesystem::rename(temporary_path, path, error);
+			if (!error) return true;
+
+			std::cout << "Failed to replace file: " << error.message() << '\n';
+		}
+
+		std::filesystem::remove(temporary_path, error);
+		return false;
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace File
+{
+	// Read only view of a whole file mapped into memory, the OS pages it in as it gets read instead of copying it through a buffer
+	class MappedFile
+	{
+	public:
+		explicit MappedFile(const std::filesystem::path& path);
+
+		MappedFile(MappedFile&) = delete;
+		MappedFile(MappedFile&&) = delete;
+		MappedFile& operator=(MappedFile&) = delete;
+		MappedFile& operator=(MappedFile&&) = delete;
+
+		~MappedFile();
+
+		[[nodiscard]] bool IsValid() const { return data != nullptr; }
+		[[nodiscard]] const uint8_t* GetData() const { return data; }
+		[[nodiscard]] size_t GetSize() const { return size; }
+
+	private:
+		const uint8_t* data{ nullptr };
+		size_t size{ 0 };
+
+#ifdef _WIN32
+		void* file_handle{ nullptr };
+		void* mapping_handle{ nullptr };
+#endif
+	};
+
+	// Writes to a temporary file next to path and renames it over path once everything is written,
+	// so a crash or a full disk halfway through never leaves a broken file behind
+	bool WriteAtomically(const std::filesystem::path& path, const void* data, size_t size);
+}
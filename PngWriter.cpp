@@ -0,0 +1,562 @@
+#include "PngWriter.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <SDL3/SDL_error.h>
+#include <SDL3/SDL_iostream.h>
+
+#include "ThreadPool.hpp"
+
+namespace PngWriter
+{
+	namespace
+	{
+		// Roughly how much filtered data goes into a band, wide images just get fewer rows per band
+		constexpr size_t BAND_SIZE{ 1024 * 1024 };
+
+		// Compressed bands are small, but a huge noisy canvas could still add up
+		constexpr size_t BAND_CACHE_BUDGET{ 128 * 1024 * 1024 };
+
+		constexpr size_t WINDOW_SIZE{ 32768 };
+		constexpr size_t MIN_MATCH{ 3 };
+		constexpr size_t MAX_MATCH{ 258 };
+		constexpr int HASH_BITS{ 15 };
+
+		constexpr std::array<uint8_t, 8> PNG_SIGNATURE{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+		// Deflate with a 32K window and no preset dictionary
+		constexpr std::array<uint8_t, 2> ZLIB_HEADER{ 0x78, 0x01 };
+
+		constexpr std::array<uint16_t, 29> LENGTH_BASE{ 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		constexpr std::array<uint8_t, 29> LENGTH_EXTRA_BITS{ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		constexpr std::array<uint16_t, 30> DISTANCE_BASE{ 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		constexpr std::array<uint8_t, 30> DISTANCE_EXTRA_BITS{ 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+		struct Preset
+		{
+			// Tries every filter per row instead of always using Paeth
+			bool adaptive_filter;
+
+			// How many earlier positions with the same hash get checked for a match, more compresses better but slower
+			int max_chain_length;
+
+			// Checks whether the next position has a longer match before committing to the current one
+			bool lazy_matching;
+		};
+
+		constexpr std::array<Preset, 3> PRESETS
+		{ {
+			{ false, 4, false },	// Fast
+			{ true, 32, false },	// Balanced
+			{ true, 512, true },	// Smallest
+		} };
+
+		constexpr std::array<uint32_t, 256> CRC_TABLE = []
+			{
+				std::array<uint32_t, 256> table{};
+				for (uint32_t i = 0; i < 256; i++)
+				{
+					uint32_t crc = i;
+					for (int bit = 0; bit < 8; bit++) crc = (crc & 1) ? 0xEDB88320 ^ (crc >> 1) : crc >> 1;
+					table.at(i) = crc;
+				}
+				return table;
+			}();
+
+		uint32_t UpdateCrc(uint32_t crc, const uint8_t* data, const size_t size)
+		{
+			for (size_t i = 0; i < size; i++) crc = CRC_TABLE[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+			return crc;
+		}
+
+		uint32_t UpdateAdler(const uint32_t adler, const uint8_t* data, size_t size)
+		{
+			// The largest amount of bytes that can be summed before the 32 bit sums could overflow
+			constexpr size_t MAX_BLOCK{ 5552 };
+			constexpr uint32_t MODULO{ 65521 };
+
+			uint32_t a = adler & 0xFFFF;
+			uint32_t b = adler >> 16;
+			while (size > 0)
+			{
+				const size_t block = std::min<size_t>(size, MAX_BLOCK);
+				for (size_t i = 0; i < block; i++)
+				{
+					a += data[i];
+					b += a;
+				}
+
+				a %= MODULO;
+				b %= MODULO;
+				data += block;
+				size -= block;
+			}
+
+			return (b << 16) | a;
+		}
+
+		// Checksum of two pieces back to back from the checksums of each piece, same math as zlib's adler32_combine
+		uint32_t CombineAdler(const uint32_t first, const uint32_t second, const size_t second_size)
+		{
+			constexpr uint64_t MODULO{ 65521 };
+
+			const uint64_t remainder = second_size % MODULO;
+			uint64_t a = first & 0xFFFF;
+			uint64_t b = (remainder * a) % MODULO;
+
+			a += (second & 0xFFFF) + MODULO - 1;
+			b += (first >> 16) + (second >> 16) + MODULO - remainder;
+
+			a %= MODULO;
+			b %= MODULO;
+			return static_cast<uint32_t>((b << 16) | a);
+		}
+
+		void StoreBigEndian(uint8_t* output, const uint32_t value)
+		{
+			output[0] = static_cast<uint8_t>(value >> 24);
+			output[1] = static_cast<uint8_t>(value >> 16);
+			output[2] = static_cast<uint8_t>(value >> 8);
+			output[3] = static_cast<uint8_t>(value);
+		}
+
+		// Deflate packs bits starting from the least significant bit of each byte
+		class BitWriter
+		{
+		public:
+			explicit BitWriter(std::vector<uint8_t>& output) : output{ output } {}
+
+			void Write(const uint32_t bits, const int count)
+			{
+				buffer |= bits << bit_count;
+				bit_count += count;
+				while (bit_count >= 8)
+				{
+					output.push_back(static_cast<uint8_t>(buffer));
+					buffer >>= 8;
+					bit_count -= 8;
+				}
+			}
+
+			// Huffman codes are the exception, those go most significant bit first
+			void WriteCode(const uint32_t code, const int length)
+			{
+				uint32_t reversed = 0;
+				for (int i = 0; i < length; i++) reversed |= ((code >> i) & 1) << (length - 1 - i);
+
+				Write(reversed, length);
+			}
+
+			void AlignToByte()
+			{
+				if (bit_count > 0) Write(0, 8 - bit_count);
+			}
+
+			void WriteBytes(const uint8_t* bytes, const size_t size)
+			{
+				output.insert(output.end(), bytes, bytes + size);
+			}
+
+		private:
+			std::vector<uint8_t>& output;
+			uint32_t buffer{ 0 };
+			int bit_count{ 0 };
+		};
+
+		// Codes from the fixed Huffman table, so no tables need to be built or stored per block
+		void WriteLiteral(BitWriter& writer, const int value)
+		{
+			if (value <= 143) writer.WriteCode(0x30 + value, 8);
+			else if (value <= 255) writer.WriteCode(0x190 + value - 144, 9);
+			else if (value <= 279) writer.WriteCode(value - 256, 7);
+			else writer.WriteCode(0xC0 + value - 280, 8);
+		}
+
+		void WriteMatch(BitWriter& writer, const size_t length, const size_t distance)
+		{
+			size_t length_code = 0;
+			while (length_code + 1 < LENGTH_BASE.size() && LENGTH_BASE.at(length_code + 1) <= length) length_code++;
+
+			WriteLiteral(writer, 257 + static_cast<int>(length_code));
+			writer.Write(static_cast<uint32_t>(length - LENGTH_BASE.at(length_code)), LENGTH_EXTRA_BITS.at(length_code));
+
+			size_t distance_code = 0;
+			while (distance_code + 1 < DISTANCE_BASE.size() && DISTANCE_BASE.at(distance_code + 1) <= distance) distance_code++;
+
+			writer.WriteCode(static_cast<uint32_t>(distance_code), 5);
+			writer.Write(static_cast<uint32_t>(distance - DISTANCE_BASE.at(distance_code)), DISTANCE_EXTRA_BITS.at(distance_code));
+		}
+
+		uint32_t Hash(const uint8_t* data)
+		{
+			const uint32_t value = (static_cast<uint32_t>(data[0]) << 16) | (static_cast<uint32_t>(data[1]) << 8) | data[2];
+			return (value * 2654435761u) >> (32 - HASH_BITS);
+		}
+
+		struct Match
+		{
+			size_t length{ 0 };
+			size_t distance{ 0 };
+		};
+
+		Match FindMatch(const uint8_t* data, const size_t size, const size_t position, const std::vector<int32_t>& head, const std::vector<int32_t>& previous, const int max_chain_length)
+		{
+			Match best;
+			if (position + MIN_MATCH > size) return best;
+
+			const size_t max_length = std::min<size_t>(MAX_MATCH, size - position);
+
+			int32_t candidate = head.at(Hash(data + position));
+			for (int chain = 0; candidate >= 0 && chain < max_chain_length; chain++)
+			{
+				const size_t distance = position - static_cast<size_t>(candidate);
+				if (distance > WINDOW_SIZE) break;
+
+				size_t length = 0;
+				while (length < max_length && data[candidate + length] == data[position + length]) length++;
+
+				if (length > best.length)
+				{
+					best = { length, distance };
+					if (length == max_length) break;
+				}
+
+				candidate = previous.at(candidate);
+			}
+
+			return best;
+		}
+
+		// Compresses a band into a single fixed Huffman block followed by a sync flush, matches never reach back into earlier bands.
+		// That leaves the output on a byte boundary without ending the stream, so bands compressed separately can just be appended to each other
+		void DeflateBand(const uint8_t* data, const size_t size, const Preset& preset, std::vector<int32_t>& head, std::vector<int32_t>& previous, std::vector<uint8_t>& output)
+		{
+			BitWriter writer{ output };
+			writer.Write(0, 1); // Not the final block
+			writer.Write(1, 2); // Fixed Huffman codes
+
+			std::ranges::fill(head, -1);
+			previous.resize(size);
+
+			const auto insert = [data, size, &head, &previous](const size_t position)
+				{
+					if (position + MIN_MATCH > size) return;
+
+					const uint32_t hash = Hash(data + position);
+					previous.at(position) = head.at(hash);
+					head.at(hash) = static_cast<int32_t>(position);
+				};
+
+			size_t position = 0;
+			while (position < size)
+			{
+				const Match match = FindMatch(data, size, position, head, previous, preset.max_chain_length);
+				insert(position);
+
+				if (match.length < MIN_MATCH)
+				{
+					WriteLiteral(writer, data[position]);
+					position++;
+					continue;
+				}
+
+				// A longer match one byte later is worth more than the literal it costs
+				if (preset.lazy_matching && FindMatch(data, size, position + 1, head, previous, preset.max_chain_length).length > match.length)
+				{
+					WriteLiteral(writer, data[position]);
+					position++;
+					continue;
+				}
+
+				WriteMatch(writer, match.length, match.distance);
+
+				// The positions inside the match can still be the start of later matches
+				for (size_t skipped = position + 1; skipped < position + match.length; skipped++) insert(skipped);
+				position += match.length;
+			}
+
+			WriteLiteral(writer, 256); // End of block
+
+			// Sync flush, an empty stored block
+			writer.Write(0, 3);
+			writer.AlignToByte();
+
+			constexpr std::array<uint8_t, 4> EMPTY_STORED_LENGTH{ 0x00, 0x00, 0xFF, 0xFF };
+			writer.WriteBytes(EMPTY_STORED_LENGTH.data(), EMPTY_STORED_LENGTH.size());
+		}
+
+		int Paeth(const int a, const int b, const int c)
+		{
+			const int p = a + b - c;
+			const int pa = std::abs(p - a);
+			const int pb = std::abs(p - b);
+			const int pc = std::abs(p - c);
+			if (pa <= pb && pa <= pc) return a;
+			if (pb <= pc) return b;
+			return c;
+		}
+
+		// Previous row is nullptr for the first row of the image, which filters as if it were all zeroes
+		template <typename Predictor>
+		void FilterRow(const uint8_t* row, const uint8_t* previous_row, const size_t row_size, uint8_t* output, const Predictor& predictor)
+		{
+			for (size_t i = 0; i < row_size; i++)
+			{
+				const int left = i >= 4 ? row[i - 4] : 0;
+				const int up = previous_row != nullptr ? previous_row[i] : 0;
+				const int up_left = i >= 4 && previous_row != nullptr ? previous_row[i - 4] : 0;
+
+				output[i] = static_cast<uint8_t>(row[i] - predictor(left, up, up_left));
+			}
+		}
+
+		void FilterRow(const uint8_t* row, const uint8_t* previous_row, const size_t row_size, const uint8_t filter, uint8_t* output)
+		{
+			switch (filter)
+			{
+			case 0: FilterRow(row, previous_row, row_size, output, [](int, int, int) { return 0; }); break;
+			case 1: FilterRow(row, previous_row, row_size, output, [](const int left, int, int) { return left; }); break;
+			case 2: FilterRow(row, previous_row, row_size, output, [](int, const int up, int) { return up; }); break;
+			case 3: FilterRow(row, previous_row, row_size, output, [](const int left, const int up, int) { return (left + up) / 2; }); break;
+			default: FilterRow(row, previous_row, row_size, output, &Paeth); break;
+			}
+		}
+
+		constexpr uint8_t PAETH_FILTER{ 4 };
+
+		// Tries every filter and keeps the one whose output is closest to zero, the same heuristic libpng and stb use
+		void FilterRowAdaptive(const uint8_t* row, const uint8_t* previous_row, const size_t row_size, uint8_t* output, std::vector<uint8_t>& scratch)
+		{
+			scratch.resize(row_size);
+
+			uint64_t best_cost = std::numeric_limits<uint64_t>::max();
+			for (uint8_t filter = 0; filter < 5; filter++)
+			{
+				FilterRow(row, previous_row, row_size, filter, scratch.data());
+
+				uint64_t cost = 0;
+				for (const uint8_t value : scratch) cost += static_cast<uint64_t>(std::abs(static_cast<int8_t>(value)));
+
+				if (cost >= best_cost) continue;
+
+				best_cost = cost;
+				output[0] = filter;
+				std::ranges::copy(scratch, output + 1);
+			}
+		}
+
+		// The compressed bytes of a band with their adler and filtered size, which is all the zlib stream needs to take it as is.
+		// Shared through band_cache with the next export
+		struct EncodedBand
+		{
+			std::vector<uint8_t> compressed;
+			uint32_t adler{ 1 };
+			size_t filtered_size{ 0 };
+		};
+
+		// Re-exporting the same banner usually only changes a few bands (the clock), the rest can be copied from the last export
+		using BandCache = std::unordered_map<uint64_t, std::shared_ptr<const EncodedBand>>;
+
+		std::mutex band_cache_mutex;
+		BandCache band_cache;
+
+		uint64_t Mix(uint64_t value)
+		{
+			value ^= value >> 33;
+			value *= 0xFF51AFD7ED558CCDull;
+			value ^= value >> 33;
+			value *= 0xC4CEB9FE1A85EC53ull;
+			value ^= value >> 33;
+			return value;
+		}
+
+		// Not cryptographic, just has to be a lot faster than compressing the band and rarely collide
+		uint64_t HashBytes(uint64_t hash, const uint8_t* data, const size_t size)
+		{
+			size_t i = 0;
+			for (; i + 8 <= size; i += 8)
+			{
+				uint64_t value;
+				std::memcpy(&value, data + i, sizeof(value));
+				hash = Mix(hash ^ value) + i;
+			}
+
+			for (; i < size; i++) hash = Mix(hash ^ data[i]);
+			return Mix(hash ^ size);
+		}
+
+		// Everything a band needs while it gets encoded, reused by the next band that lands on the same slot
+		struct Band
+		{
+			std::vector<uint8_t> filtered;
+			std::vector<uint8_t> scratch;
+			std::vector<int32_t> head = std::vector<int32_t>(static_cast<size_t>(1) << HASH_BITS);
+			std::vector<int32_t> previous;
+
+			uint64_t key{ 0 };
+			std::shared_ptr<const EncodedBand> encoded;
+		};
+
+		// The filters read the row above the band too, so it is part of the key
+		uint64_t GetBandKey(const uint8_t* pixels, const size_t row_size, const int first_row, const int row_count, const Compression compression)
+		{
+			uint64_t key = Mix((static_cast<uint64_t>(row_size) << 8) | static_cast<uint64_t>(compression));
+			const uint8_t* band_start = pixels + static_cast<size_t>(first_row) * row_size;
+
+			if (first_row > 0) key = HashBytes(key, band_start - row_size, row_size);
+			return HashBytes(key, band_start, static_cast<size_t>(row_count) * row_size);
+		}
+
+		// Only reads the row above the band from outside of it, so bands can be encoded in any order
+		void EncodeBand(const uint8_t* pixels, const size_t row_size, const int first_row, const int row_count, const Preset& preset, Band& band)
+		{
+			band.filtered.resize(static_cast<size_t>(row_count) * (row_size + 1));
+			for (int i = 0; i < row_count; i++)
+			{
+				const uint8_t* row = pixels + static_cast<size_t>(first_row + i) * row_size;
+				const uint8_t* previous_row = first_row + i > 0 ? row - row_size : nullptr;
+				uint8_t* output = band.filtered.data() + static_cast<size_t>(i) * (row_size + 1);
+
+				if (preset.adaptive_filter)
+				{
+					FilterRowAdaptive(row, previous_row, row_size, output, band.scratch);
+				}
+				else
+				{
+					output[0] = PAETH_FILTER;
+					FilterRow(row, previous_row, row_size, PAETH_FILTER, output + 1);
+				}
+			}
+
+			auto encoded = std::make_shared<EncodedBand>();
+			encoded->adler = UpdateAdler(1, band.filtered.data(), band.filtered.size());
+			encoded->filtered_size = band.filtered.size();
+
+			DeflateBand(band.filtered.data(), band.filtered.size(), preset, band.head, band.previous, encoded->compressed);
+			band.encoded = std::move(encoded);
+		}
+
+		bool WriteChunk(SDL_IOStream* stream, const char* type, const uint8_t* data, const size_t size)
+		{
+			std::array<uint8_t, 8> header;
+			StoreBigEndian(header.data(), static_cast<uint32_t>(size));
+			std::copy_n(type, 4, header.data() + 4);
+
+			std::array<uint8_t, 4> crc;
+			StoreBigEndian(crc.data(), ~UpdateCrc(UpdateCrc(0xFFFFFFFF, header.data() + 4, 4), data, size));
+
+			return SDL_WriteIO(stream, header.data(), header.size()) == header.size() &&
+				(size == 0 || SDL_WriteIO(stream, data, size) == size) &&
+				SDL_WriteIO(stream, crc.data(), crc.size()) == crc.size();
+		}
+	}
+
+	bool Write(const std::string& path, const int width, const int height, const uint8_t* pixels, std::atomic<float>& progress, const std::atomic<bool>& cancelled,
+		const Compression compression)
+	{
+		progress = 0.0f;
+		if (width <= 0 || height <= 0 || pixels == nullptr) return false;
+
+		SDL_IOStream* stream = SDL_IOFromFile(path.c_str(), "wb");
+		if (stream == nullptr)
+		{
+			std::cout << "Failed to open export file: " << SDL_GetError() << '\n';
+			return false;
+		}
+
+		const Preset& preset = PRESETS.at(static_cast<size_t>(compression));
+		const size_t row_size = 4 * static_cast<size_t>(width);
+		const int rows_per_band = static_cast<int>(std::clamp<size_t>(BAND_SIZE / (row_size + 1), 1, static_cast<size_t>(height)));
+		const int band_count = (height + rows_per_band - 1) / rows_per_band;
+
+		std::array<uint8_t, 13> header{};
+		StoreBigEndian(header.data(), static_cast<uint32_t>(width));
+		StoreBigEndian(header.data() + 4, static_cast<uint32_t>(height));
+		header.at(8) = 8; // Bits per channel
+		header.at(9) = 6; // RGBA
+
+		bool succeeded = SDL_WriteIO(stream, PNG_SIGNATURE.data(), PNG_SIGNATURE.size()) == PNG_SIGNATURE.size() &&
+			WriteChunk(stream, "IHDR", header.data(), header.size()) &&
+			WriteChunk(stream, "IDAT", ZLIB_HEADER.data(), ZLIB_HEADER.size());
+
+		// One band per thread is encoded at a time, then written in order. Memory stays bounded by the thread count instead of the image size
+		std::vector<Band> bands(std::min<size_t>(ThreadPool::GetThreadCount(), static_cast<size_t>(band_count)));
+
+		// Only read by the workers, the bands of this export replace it once we're done
+		BandCache previous_bands;
+		{
+			std::lock_guard lock{ band_cache_mutex };
+			previous_bands = band_cache;
+		}
+
+		BandCache current_bands;
+		size_t cached_size = 0;
+
+		uint32_t adler = 1;
+		for (int first_band = 0; succeeded && first_band < band_count; first_band += static_cast<int>(bands.size()))
+		{
+			const int batch_size = std::min<int>(static_cast<int>(bands.size()), band_count - first_band);
+			ThreadPool::ParallelFor(static_cast<size_t>(batch_size), [&](const size_t i)
+				{
+					const int first_row = (first_band + static_cast<int>(i)) * rows_per_band;
+					const int row_count = std::min<int>(rows_per_band, height - first_row);
+
+					Band& band = bands.at(i);
+					band.key = GetBandKey(pixels, row_size, first_row, row_count, compression);
+
+					const auto cached_band = previous_bands.find(band.key);
+					if (cached_band != previous_bands.end()) band.encoded = cached_band->second;
+					else EncodeBand(pixels, row_size, first_row, row_count, preset, band);
+				});
+
+			for (int i = 0; succeeded && i < batch_size; i++)
+			{
+				Band& band = bands.at(i);
+				const EncodedBand& encoded = *band.encoded;
+
+				adler = CombineAdler(adler, encoded.adler, encoded.filtered_size);
+				succeeded = WriteChunk(stream, "IDAT", encoded.compressed.data(), encoded.compressed.size());
+
+				if (cached_size + encoded.compressed.size() <= BAND_CACHE_BUDGET && current_bands.emplace(band.key, band.encoded).second)
+				{
+					cached_size += encoded.compressed.size();
+				}
+
+				band.encoded.reset();
+			}
+
+			progress = static_cast<float>(std::min<int>((first_band + batch_size) * rows_per_band, height)) / static_cast<float>(height);
+			if (cancelled) succeeded = false;
+		}
+
+		// An empty final block ends the stream, then the checksum of everything before compression
+		std::array<uint8_t, 6> stream_end{ 0x03, 0x00 };
+		StoreBigEndian(stream_end.data() + 2, adler);
+
+		succeeded = succeeded && WriteChunk(stream, "IDAT", stream_end.data(), stream_end.size()) && WriteChunk(stream, "IEND", nullptr, 0);
+		if (!succeeded && !cancelled) std::cout << "Failed to write export file: " << SDL_GetError() << '\n';
+
+		if (succeeded)
+		{
+			std::lock_guard lock{ band_cache_mutex };
+			band_cache = std::move(current_bands);
+		}
+
+		if (!SDL_CloseIO(stream))
+		{
+			std::cout << "Failed to close export file: " << SDL_GetError() << '\n';
+			return false;
+		}
+
+		return succeeded;
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace PngWriter
+{
+	enum class Compression : uint8_t
+	{
+		Fast,		// Paeth filter on every row, short match search
+		Balanced,	// Best filter per row, same as most PNG writers
+		Smallest,	// Best filter per row, long match search with lazy matching
+	};
+
+	constexpr std::array<const char*, 3> COMPRESSION_NAMES{ "Fast", "Balanced", "Smallest" };
+
+	// Filters and compresses the image in bands of rows spread over the thread pool, writing the bands to the file in order as they finish.
+	// Memory use only depends on the thread count, not on the image size. Progress goes from 0 to 1 as bands get written.
+	// Bands with the same pixels as in the last export are reused from it instead of being compressed again.
+	// Cancelled is checked between batches of bands, the file is left incomplete when it gets set
+	bool Write(const std::string& path, int width, int height, const uint8_t* pixels, std::atomic<float>& progress, const std::atomic<bool>& cancelled,
+		Compression compression = Compression::Balanced);
+}
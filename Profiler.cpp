@@ -0,0 +1,77 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+using namespace std::chrono;
+
+namespace Profiler
+{
+	namespace
+	{
+		std::atomic<bool> profiling{ false };
+
+		std::array<duration<float, std::milli>, STAGE_NAMES.size()> stage_times{};
+		std::array<std::atomic<uint64_t>, COUNTER_NAMES.size()> counters{};
+		steady_clock::time_point frame_start{ steady_clock::now() };
+
+		History history;
+	}
+
+	void SetEnabled(const bool enabled)
+	{
+		if (enabled && !profiling) frame_start = steady_clock::now();
+		profiling = enabled;
+	}
+
+	bool IsEnabled()
+	{
+		return profiling.load(std::memory_order_relaxed);
+	}
+
+	ScopedTimer::ScopedTimer(const Stage stage) : stage{ stage }
+	{
+		if (IsEnabled()) start = steady_clock::now();
+	}
+
+	ScopedTimer::~ScopedTimer()
+	{
+		// Timers that started before profiling was turned on have no start
+		if (IsEnabled() && start != steady_clock::time_point{}) stage_times.at(static_cast<size_t>(stage)) += steady_clock::now() - start;
+	}
+
+	void Count(const Counter counter, const uint64_t amount)
+	{
+		if (IsEnabled()) counters.at(static_cast<size_t>(counter)).fetch_add(amount, std::memory_order_relaxed);
+	}
+
+	void EndFrame()
+	{
+		if (!IsEnabled()) return;
+
+		const steady_clock::time_point now = steady_clock::now();
+		const duration<float, std::milli> waiting = stage_times.at(static_cast<size_t>(Stage::Waiting));
+		history.frame_milliseconds.at(history.next) = std::max<float>((duration<float, std::milli>{ now - frame_start } - waiting).count(), 0.0f);
+		frame_start = now;
+
+		for (size_t i = 0; i < stage_times.size(); i++)
+		{
+			history.stage_milliseconds.at(i).at(history.next) = stage_times.at(i).count();
+			stage_times.at(i) = {};
+		}
+
+		for (size_t i = 0; i < counters.size(); i++)
+		{
+			history.last_counters.at(i) = counters.at(i).exchange(0, std::memory_order_relaxed);
+			history.total_counters.at(i) += history.last_counters.at(i);
+		}
+
+		history.next = (history.next + 1) % HISTORY_SIZE;
+		history.count = std::min<size_t>(history.count + 1, HISTORY_SIZE);
+	}
+
+	const History& GetHistory()
+	{
+		return history;
+	}
+}
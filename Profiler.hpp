@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+// Where the time of a frame goes. Stages are timed with ScopedTimer, counters count how often expensive things happen.
+// Nothing is recorded until it is enabled, so the timers can stay in the hot paths
+namespace Profiler
+{
+	// Text and Upload happen inside the other stages, so their time is counted there as well
+	enum class Stage : uint8_t
+	{
+		Waiting,	// Idle waiting for events and the frame rate cap, not counted as frame time
+		Events,
+		Textures,
+		Composite,
+		Canvas,
+		UI,
+		ImGuiRender,
+		Present,
+		Text,
+		Upload,
+	};
+
+	constexpr std::array<const char*, 10> STAGE_NAMES{ "Waiting", "Events", "Textures", "Composite", "Canvas", "UI", "ImGui render", "Present", "Text", "Upload" };
+
+	// Safe to count from any thread
+	enum class Counter : uint8_t
+	{
+		TexturesCreated,
+		BytesUploaded,
+		GlyphsRasterized,
+		TextTextures,	// Calls to CreateTextTexture, most of them are answered by the texture cache
+	};
+
+	constexpr std::array<const char*, 4> COUNTER_NAMES{ "Textures created", "Bytes uploaded", "Glyphs rasterized", "Text textures" };
+
+	constexpr size_t HISTORY_SIZE{ 240 };
+
+	// The last HISTORY_SIZE frames, oldest first starting at next once it is full
+	struct History
+	{
+		std::array<std::array<float, HISTORY_SIZE>, STAGE_NAMES.size()> stage_milliseconds{};
+		std::array<float, HISTORY_SIZE> frame_milliseconds{};
+		size_t next{ 0 };
+		size_t count{ 0 };
+
+		std::array<uint64_t, COUNTER_NAMES.size()> last_counters{};
+		std::array<uint64_t, COUNTER_NAMES.size()> total_counters{};
+	};
+
+	void SetEnabled(bool enabled);
+	[[nodiscard]] bool IsEnabled();
+
+	// Times the rest of the scope. Only from the main thread
+	class ScopedTimer
+	{
+	public:
+		explicit ScopedTimer(Stage stage);
+		~ScopedTimer();
+
+		ScopedTimer(ScopedTimer&) = delete;
+		ScopedTimer(ScopedTimer&&) = delete;
+		ScopedTimer& operator=(ScopedTimer&) = delete;
+		ScopedTimer& operator=(ScopedTimer&&) = delete;
+
+	private:
+		Stage stage;
+		std::chrono::steady_clock::time_point start;
+	};
+
+	void Count(Counter counter, uint64_t amount = 1);
+
+	// Moves everything recorded since the last call into the history, once at the end of every frame
+	void EndFrame();
+
+	[[nodiscard]] const History& GetHistory();
+}
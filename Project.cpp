@@ -0,0 +1,550 @@
+#include "Project.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "Fonts.hpp"
+#include "Image.hpp"
+#include "ImageCache.hpp"
+#include "Json.hpp"
+#include "Layout.hpp"
+#include "MappedFile.hpp"
+#include "ThreadPool.hpp"
+
+// The file starts with a header and a table of sections, each section is a blob somewhere after the table.
+// Everything is stored little endian, like every platform this runs on
+namespace Project
+{
+	namespace
+	{
+		constexpr std::array<char, 4> MAGIC{ 'T', 'B', 'P', 'J' };
+
+		// Same limit as the JSON parser, layouts are never nested anywhere near this deep
+		constexpr int MAX_DEPTH{ 128 };
+
+		enum class SectionType : uint32_t
+		{
+			Layout = 1,	// The layout, as a binary encoding of its JSON
+			Images = 2,	// Decoded pixels together with the image cache key they belong to
+			UncheckedGlyphs = 3,	// Glyphs from before fonts were saved with their file's modification time and size, skipped since they can't be checked
+			Glyphs = 4,	// Rasterized glyphs of every font the text layers use
+		};
+
+		struct Header
+		{
+			std::array<char, 4> magic{ MAGIC };
+			uint32_t version{ VERSION };
+			uint32_t section_count{ 0 };
+			uint32_t reserved{ 0 };
+		};
+
+		struct Section
+		{
+			SectionType type{};
+			uint32_t reserved{ 0 };
+			uint64_t offset{ 0 };
+			uint64_t size{ 0 };
+		};
+
+		enum class ValueTag : uint8_t
+		{
+			Null,
+			False,
+			True,
+			Number,
+			String,
+			Array,
+			Object,
+		};
+
+		class Writer
+		{
+		public:
+			template <typename T>
+			void Write(const T& value)
+			{
+				static_assert(std::is_trivially_copyable_v<T>);
+				WriteBytes(&value, sizeof(T));
+			}
+
+			void WriteBytes(const void* bytes, const size_t size)
+			{
+				const auto* begin = static_cast<const uint8_t*>(bytes);
+				data.insert(data.end(), begin, begin + size);
+			}
+
+			void WriteString(const std::string_view string)
+			{
+				Write(static_cast<uint32_t>(string.size()));
+				WriteBytes(string.data(), string.size());
+			}
+
+			// For filling in the section table once the sections are written
+			template <typename T>
+			void Overwrite(const size_t position, const T& value)
+			{
+				static_assert(std::is_trivially_copyable_v<T>);
+				std::memcpy(data.data() + position, &value, sizeof(T));
+			}
+
+			[[nodiscard]] size_t GetSize() const { return data.size(); }
+			[[nodiscard]] const std::vector<uint8_t>& GetData() const { return data; }
+
+		private:
+			std::vector<uint8_t> data;
+		};
+
+		// Reads straight from the mapped file, every read checks that there is enough left so a truncated or corrupt file just fails to load
+		class Reader
+		{
+		public:
+			Reader(const uint8_t* data, const size_t size) : data{ data }, size{ size } {}
+
+			template <typename T>
+			[[nodiscard]] bool Read(T& value)
+			{
+				static_assert(std::is_trivially_copyable_v<T>);
+				const uint8_t* bytes = ReadBytes(sizeof(T));
+				if (bytes == nullptr) return false;
+
+				std::memcpy(&value, bytes, sizeof(T));
+				return true;
+			}
+
+			// nullptr when there aren't that many bytes left
+			[[nodiscard]] const uint8_t* ReadBytes(const uint64_t byte_count)
+			{
+				if (byte_count > size - position) return nullptr;
+
+				const uint8_t* bytes = data + position;
+				position += static_cast<size_t>(byte_count);
+				return bytes;
+			}
+
+			[[nodiscard]] bool ReadString(std::string& string)
+			{
+				uint32_t length = 0;
+				if (!Read(length)) return false;
+
+				const uint8_t* bytes = ReadBytes(length);
+				if (bytes == nullptr) return false;
+
+				string.assign(reinterpret_cast<const char*>(bytes), length);
+				return true;
+			}
+
+			[[nodiscard]] size_t GetRemaining() const { return size - position; }
+
+		private:
+			const uint8_t* data;
+			size_t size;
+			size_t position{ 0 };
+		};
+
+		void WriteValue(Writer& writer, const Json::Value& value)
+		{
+			if (value.IsBool()) writer.Write(value.GetBool() ? ValueTag::True : ValueTag::False);
+			else if (value.IsNumber())
+			{
+				writer.Write(ValueTag::Number);
+				writer.Write(value.GetNumber());
+			}
+			else if (value.IsString())
+			{
+				writer.Write(ValueTag::String);
+				writer.WriteString(value.GetString());
+			}
+			else if (value.IsArray())
+			{
+				writer.Write(ValueTag::Array);
+				writer.Write(static_cast<uint32_t>(value.GetArray().size()));
+				for (const Json::Value& element : value.GetArray()) WriteValue(writer, element);
+			}
+			else if (value.IsObject())
+			{
+				writer.Write(ValueTag::Object);
+				writer.Write(static_cast<uint32_t>(value.GetObject().size()));
+				for (const auto& [key, member] : value.GetObject())
+				{
+					writer.WriteString(key);
+					WriteValue(writer, member);
+				}
+			}
+			else writer.Write(ValueTag::Null);
+		}
+
+		bool ReadValue(Reader& reader, Json::Value& value, const int depth)
+		{
+			ValueTag tag{};
+			if (depth > MAX_DEPTH || !reader.Read(tag)) return false;
+
+			switch (tag)
+			{
+			case ValueTag::Null:
+				value = {};
+				return true;
+
+			case ValueTag::False:
+			case ValueTag::True:
+				value = tag == ValueTag::True;
+				return true;
+
+			case ValueTag::Number:
+			{
+				double number = 0.0;
+				if (!reader.Read(number)) return false;
+
+				value = number;
+				return true;
+			}
+
+			case ValueTag::String:
+			{
+				std::string string;
+				if (!reader.ReadString(string)) return false;
+
+				value = std::move(string);
+				return true;
+			}
+
+			case ValueTag::Array:
+			{
+				uint32_t count = 0;
+				if (!reader.Read(count)) return false;
+
+				// Every element takes at least its tag, so a corrupt count can't make this reserve gigabytes
+				Json::Array array;
+				array.reserve(std::min<size_t>(count, reader.GetRemaining()));
+				for (uint32_t i = 0; i < count; i++)
+				{
+					if (!ReadValue(reader, array.emplace_back(), depth + 1)) return false;
+				}
+
+				value = std::move(array);
+				return true;
+			}
+
+			case ValueTag::Object:
+			{
+				uint32_t count = 0;
+				if (!reader.Read(count)) return false;
+
+				Json::Object object;
+				for (uint32_t i = 0; i < count; i++)
+				{
+					std::string key;
+					Json::Value member;
+					if (!reader.ReadString(key) || !ReadValue(reader, member, depth + 1)) return false;
+
+					object.insert_or_assign(std::move(key), std::move(member));
+				}
+
+				value = std::move(object);
+				return true;
+			}
+			}
+
+			return false;
+		}
+
+		void WriteResizeSettings(Writer& writer, const ImageResize::Settings& settings)
+		{
+			writer.Write(settings.quality);
+			writer.Write(static_cast<uint8_t>(settings.srgb));
+			writer.Write(static_cast<uint8_t>(settings.premultiply_alpha));
+		}
+
+		bool ReadResizeSettings(Reader& reader, ImageResize::Settings& settings)
+		{
+			uint8_t quality = 0;
+			uint8_t srgb = 0;
+			uint8_t premultiply_alpha = 0;
+			if (!reader.Read(quality) || !reader.Read(srgb) || !reader.Read(premultiply_alpha) || quality >= ImageResize::QUALITY_NAMES.size()) return false;
+
+			settings = { static_cast<ImageResize::Quality>(quality), srgb != 0, premultiply_alpha != 0 };
+			return true;
+		}
+
+		void WriteImages(Writer& writer)
+		{
+			std::vector<const Image::Image*> sources{ &Image::canvas->image };
+			for (const auto& image : Image::images) sources.push_back(image.get());
+
+			// Layers using the same file at the same size share their pixels, so they only need to be stored once
+			std::set<ImageCache::Key> written_keys;
+			std::vector<std::pair<ImageCache::Key, const ImageCache::Pixels*>> entries;
+			for (const Image::Image* image : sources)
+			{
+				if (image->GetFilePath().empty() || image->GetPixels() == nullptr || image->IsLoading()) continue;
+
+				// The key from when the pixels were loaded, a file that changed since then must not get the old pixels under its new key
+				const ImageCache::Key& key = image->GetPixelsKey();
+				if (written_keys.insert(key).second) entries.emplace_back(key, image->GetPixels().get());
+			}
+
+			writer.Write(static_cast<uint32_t>(entries.size()));
+			for (const auto& [key, pixels] : entries)
+			{
+				writer.WriteString(key.path);
+				writer.Write(key.modified);
+				writer.Write(static_cast<uint64_t>(key.file_size));
+				writer.Write(static_cast<int32_t>(key.width));
+				writer.Write(static_cast<int32_t>(key.height));
+				WriteResizeSettings(writer, key.resize_settings);
+
+				writer.Write(static_cast<int32_t>(pixels->width));
+				writer.Write(static_cast<int32_t>(pixels->height));
+				writer.WriteBytes(pixels->data.data(), pixels->data.size());
+			}
+		}
+
+		// Only the pixels of files that haven't changed since saving are used, they go in the image cache where the loaders will find them
+		bool ReadImages(Reader& reader)
+		{
+			struct Entry
+			{
+				ImageCache::Key key;
+				int width{ 0 };
+				int height{ 0 };
+				const uint8_t* data{ nullptr };
+			};
+
+			uint32_t count = 0;
+			if (!reader.Read(count)) return false;
+
+			std::vector<Entry> entries;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				Entry entry;
+				int32_t key_width = 0;
+				int32_t key_height = 0;
+				uint64_t file_size = 0;
+				if (!reader.ReadString(entry.key.path) || !reader.Read(entry.key.modified) || !reader.Read(file_size) ||
+					!reader.Read(key_width) || !reader.Read(key_height) || !ReadResizeSettings(reader, entry.key.resize_settings) ||
+					!reader.Read(entry.width) || !reader.Read(entry.height) || entry.width <= 0 || entry.height <= 0)
+				{
+					return false;
+				}
+
+				entry.key.file_size = file_size;
+				entry.key.width = key_width;
+				entry.key.height = key_height;
+
+				// Skipped without touching them, so the pages of the pixels only get read for the entries that are used
+				entry.data = reader.ReadBytes(static_cast<uint64_t>(entry.width) * static_cast<uint64_t>(entry.height) * 4);
+				if (entry.data == nullptr) return false;
+
+				entries.push_back(std::move(entry));
+			}
+
+			// Copying hundreds of megabytes out of the mapping (and checking every file on disk) goes a lot faster spread over the workers
+			ThreadPool::ParallelFor(entries.size(), [&entries](const size_t i)
+				{
+					const Entry& entry = entries.at(i);
+					const ImageCache::Key current_key = entry.key.width == 0 ?
+						ImageCache::MakeKey(entry.key.path) :
+						ImageCache::MakeKey(entry.key.path, entry.key.width, entry.key.height, entry.key.resize_settings);
+
+					if (current_key != entry.key || ImageCache::Find(entry.key) != nullptr) return;
+
+					ImageCache::Pixels pixels{ entry.width, entry.height };
+					pixels.data.assign(entry.data, entry.data + static_cast<size_t>(entry.width) * static_cast<size_t>(entry.height) * 4);
+					ImageCache::Insert(entry.key, std::move(pixels));
+				});
+
+			return true;
+		}
+
+		void WriteGlyphs(Writer& writer)
+		{
+			std::set<std::filesystem::path> written_fonts;
+			std::vector<std::shared_ptr<Fonts::Font>> fonts;
+			for (const auto& image : Image::images)
+			{
+				const auto* text = dynamic_cast<const Image::Text*>(image.get());
+				if (text == nullptr || !written_fonts.insert(text->GetFontPath().GetPath()).second) continue;
+
+				fonts.push_back(Fonts::GetFont(text->GetFontPath()));
+			}
+
+			writer.Write(static_cast<uint32_t>(fonts.size()));
+			for (const std::shared_ptr<Fonts::Font>& font : fonts)
+			{
+				writer.WriteString(font->GetPath().GetPath().generic_string());
+				writer.Write(font->GetFileModified());
+				writer.Write(static_cast<uint64_t>(font->GetFileSize()));
+
+				// The count is only known after visiting, so it gets filled in afterwards
+				const size_t count_position = writer.GetSize();
+				uint32_t count = 0;
+				writer.Write(count);
+
+				font->VisitCachedGlyphs([&writer, &count](const int codepoint, const float scale, const Fonts::Font::Glyph& glyph)
+					{
+						writer.Write(static_cast<int32_t>(codepoint));
+						writer.Write(scale);
+						writer.Write(glyph.bounds);
+						writer.Write(static_cast<int32_t>(glyph.advance));
+						writer.WriteBytes(glyph.bitmap.data(), glyph.bitmap.size());
+						count++;
+					});
+
+				writer.Overwrite(count_position, count);
+			}
+		}
+
+		// The fonts are kept in fonts until the layers are made, otherwise nothing would hold on to them and the glyphs would be gone again
+		bool ReadGlyphs(Reader& reader, std::vector<std::shared_ptr<Fonts::Font>>& fonts)
+		{
+			uint32_t font_count = 0;
+			if (!reader.Read(font_count)) return false;
+
+			for (uint32_t i = 0; i < font_count; i++)
+			{
+				std::string path;
+				int64_t modified = 0;
+				uint64_t file_size = 0;
+				uint32_t glyph_count = 0;
+				if (!reader.ReadString(path) || !reader.Read(modified) || !reader.Read(file_size) || !reader.Read(glyph_count)) return false;
+
+				// A missing font gets replaced by the default one and a replaced font file has other glyphs, in both cases the saved ones don't belong to it
+				std::shared_ptr<Fonts::Font> font = Fonts::GetFont(Fonts::FontPath{ path });
+				const bool matches = font->GetPath().GetPath() == std::filesystem::path{ path } && font->GetFileModified() == modified && font->GetFileSize() == file_size;
+
+				for (uint32_t j = 0; j < glyph_count; j++)
+				{
+					int32_t codepoint = 0;
+					float scale = 0.0f;
+					int32_t advance = 0;
+					Fonts::Font::Glyph glyph;
+					if (!reader.Read(codepoint) || !reader.Read(scale) || !reader.Read(glyph.bounds) || !reader.Read(advance) ||
+						glyph.bounds.w < 0 || glyph.bounds.h < 0)
+					{
+						return false;
+					}
+
+					const uint8_t* bitmap = reader.ReadBytes(static_cast<uint64_t>(glyph.bounds.w) * static_cast<uint64_t>(glyph.bounds.h));
+					if (bitmap == nullptr) return false;
+					if (!matches) continue;
+
+					glyph.advance = advance;
+					glyph.bitmap.assign(bitmap, bitmap + static_cast<size_t>(glyph.bounds.w) * static_cast<size_t>(glyph.bounds.h));
+					font->AddCachedGlyph(codepoint, scale, std::move(glyph));
+				}
+
+				if (matches) fonts.push_back(std::move(font));
+			}
+
+			return true;
+		}
+	}
+
+	bool Save(const std::filesystem::path& path, const SaveSettings& settings)
+	{
+		if (Image::canvas == nullptr) return false;
+
+		std::vector<SectionType> section_types{ SectionType::Layout };
+		if (settings.embed_images) section_types.push_back(SectionType::Images);
+		if (settings.embed_glyphs) section_types.push_back(SectionType::Glyphs);
+
+		Writer writer;
+		writer.Write(Header{ .section_count = static_cast<uint32_t>(section_types.size()) });
+
+		const size_t table_position = writer.GetSize();
+		for (size_t i = 0; i < section_types.size(); i++) writer.Write(Section{});
+
+		for (size_t i = 0; i < section_types.size(); i++)
+		{
+			Section section{ .type = section_types.at(i), .offset = writer.GetSize() };
+
+			switch (section.type)
+			{
+			case SectionType::Layout: WriteValue(writer, Layout::Capture()); break;
+			case SectionType::Images: WriteImages(writer); break;
+			case SectionType::Glyphs: WriteGlyphs(writer); break;
+			case SectionType::UncheckedGlyphs: break;
+			}
+
+			section.size = writer.GetSize() - section.offset;
+			writer.Overwrite(table_position + i * sizeof(Section), section);
+		}
+
+		return File::WriteAtomically(path, writer.GetData().data(), writer.GetSize());
+	}
+
+	std::optional<Json::Value> ReadLayout(const std::filesystem::path& path, std::vector<std::shared_ptr<Fonts::Font>>& fonts)
+	{
+		const File::MappedFile file{ path };
+		if (!file.IsValid())
+		{
+			std::cout << "Failed to open project file: " << path.generic_string() << '\n';
+			return std::nullopt;
+		}
+
+		Reader reader{ file.GetData(), file.GetSize() };
+
+		Header header;
+		if (!reader.Read(header) || header.magic != MAGIC)
+		{
+			std::cout << "Not a project file: " << path.generic_string() << '\n';
+			return std::nullopt;
+		}
+
+		if (header.version > VERSION)
+		{
+			std::cout << "Project was saved by a newer version: " << header.version << '\n';
+			return std::nullopt;
+		}
+
+		std::optional<Json::Value> layout;
+		for (uint32_t i = 0; i < header.section_count; i++)
+		{
+			Section section;
+			if (!reader.Read(section) || section.offset > file.GetSize() || section.size > file.GetSize() - section.offset)
+			{
+				std::cout << "Project file is damaged: " << path.generic_string() << '\n';
+				return std::nullopt;
+			}
+
+			Reader section_reader{ file.GetData() + section.offset, static_cast<size_t>(section.size) };
+
+			// Broken caches only cost speed, but without the layout there's nothing to open
+			switch (section.type)
+			{
+			case SectionType::Layout:
+				if (Json::Value value; ReadValue(section_reader, value, 0)) layout = std::move(value);
+				break;
+
+			case SectionType::Images:
+				if (!ReadImages(section_reader)) std::cout << "Skipped damaged images in project: " << path.generic_string() << '\n';
+				break;
+
+			case SectionType::Glyphs:
+				if (!ReadGlyphs(section_reader, fonts)) std::cout << "Skipped damaged glyphs in project: " << path.generic_string() << '\n';
+				break;
+
+			default:
+				break;
+			}
+		}
+
+		if (!layout) std::cout << "Project file has no valid layout: " << path.generic_string() << '\n';
+		return layout;
+	}
+
+	bool Load(const std::filesystem::path& path)
+	{
+		std::vector<std::shared_ptr<Fonts::Font>> fonts;
+		const std::optional<Json::Value> layout = ReadLayout(path, fonts);
+		return layout && Layout::Apply(*layout);
+	}
+}
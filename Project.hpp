@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "Fonts.hpp"
+#include "Json.hpp"
+
+// A layout in a compact binary file, which can also carry the decoded images and rasterized glyphs so opening it skips most of the work
+namespace Project
+{
+	// Bumped whenever older versions would read a project wrong. New kinds of sections don't need it, readers skip the ones they don't know
+	constexpr uint32_t VERSION{ 1 };
+	constexpr const char* EXTENSION{ ".tbp" };
+
+	struct SaveSettings
+	{
+		// Makes the file about as big as the decoded images, but opening it doesn't decode or resize them. Only used while the image files stay unchanged
+		bool embed_images{ false };
+
+		// Small, and saves rasterizing the text of every layer again
+		bool embed_glyphs{ true };
+	};
+
+	// Written to a temporary file first, so an existing project is never left half overwritten
+	bool Save(const std::filesystem::path& path, const SaveSettings& settings = {});
+
+	// The file is mapped instead of read, so embedded images that turn out to be outdated never get paged in.
+	// Layers are applied like a layout, their textures get made as the images finish loading on the workers
+	bool Load(const std::filesystem::path& path);
+
+	// Only puts the embedded images and glyphs in their caches and returns the layout, for changing it before applying it.
+	// The glyphs are only kept while something holds on to their fonts, so fonts has to live until the layout is applied
+	[[nodiscard]] std::optional<Json::Value> ReadLayout(const std::filesystem::path& path, std::vector<std::shared_ptr<Fonts::Font>>& fonts);
+}
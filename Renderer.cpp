@@ -1,12 +1,16 @@
 #include "Renderer.hpp"
 
+#include <atomic>
 #include <iostream>
 #include <filesystem>
+#include <vector>
 
 #include <SDL3/SDL_render.h>
+#include <SDL3/SDL_events.h>
 #include <SDL3/SDL_init.h>
 
 #include "Image.hpp"
+#include "Profiler.hpp"
 
 namespace Renderer
 {
@@ -25,17 +29,65 @@ namespace Renderer
 		uint32_t checkerboard_data[4]{ 0xFF8F8F8F, 0xFFBFBFBF, 0xFFBFBFBF, 0xFF8F8F8F };
 		SDL_Texture* checkerboard_texture{ nullptr };
 
+		// Stays 0 without a renderer, nothing is waiting for input then
+		std::atomic<uint32_t> redraw_event_type{ 0 };
+
 		void SetDrawColor(const uint32_t color)
 		{
 			if (!SDL_SetRenderDrawColor(renderer, color & 0xFF, (color >> 8) & 0xFF, (color >> 16) & 0xFF, color >> 24))
 				std::cout << "Failed to set draw color: " << SDL_GetError() << '\n';
 		}
+
+		// Grid lines, the selection and anything else drawn on top of the canvas are all thin quads,
+		// so however many there are they go to the GPU in a single SDL_RenderGeometry call
+		std::vector<SDL_Vertex> overlay_vertices;
+		std::vector<int> overlay_indices;
+
+		void AddOverlayRect(const SDL_FRect& rect, const uint32_t color)
+		{
+			const SDL_FColor float_color{ static_cast<float>(color & 0xFF) / 255.0f, static_cast<float>((color >> 8) & 0xFF) / 255.0f,
+				static_cast<float>((color >> 16) & 0xFF) / 255.0f, static_cast<float>(color >> 24) / 255.0f };
+
+			const int first = static_cast<int>(overlay_vertices.size());
+			overlay_vertices.push_back({ { rect.x, rect.y }, float_color, {} });
+			overlay_vertices.push_back({ { rect.x + rect.w, rect.y }, float_color, {} });
+			overlay_vertices.push_back({ { rect.x + rect.w, rect.y + rect.h }, float_color, {} });
+			overlay_vertices.push_back({ { rect.x, rect.y + rect.h }, float_color, {} });
+
+			overlay_indices.insert(overlay_indices.end(), { first, first + 1, first + 2, first + 2, first + 3, first });
+		}
+
+		// The same pixels SDL_RenderRect would draw
+		void AddOverlayOutline(const SDL_FRect& rect, const uint32_t color)
+		{
+			AddOverlayRect({ rect.x, rect.y, rect.w, 1.0f }, color);
+			AddOverlayRect({ rect.x, rect.y + rect.h - 1.0f, rect.w, 1.0f }, color);
+			if (rect.h <= 2.0f) return;
+
+			AddOverlayRect({ rect.x, rect.y + 1.0f, 1.0f, rect.h - 2.0f }, color);
+			AddOverlayRect({ rect.x + rect.w - 1.0f, rect.y + 1.0f, 1.0f, rect.h - 2.0f }, color);
+		}
+
+		void DrawOverlay()
+		{
+			if (overlay_indices.empty()) return;
+
+			if (!SDL_RenderGeometry(renderer, nullptr, overlay_vertices.data(), static_cast<int>(overlay_vertices.size()), overlay_indices.data(), static_cast<int>(overlay_indices.size())))
+				std::cout << "Failed to render overlay: " << SDL_GetError() << '\n';
+
+			// Cleared instead of freed, so the next frame doesn't allocate again
+			overlay_vertices.clear();
+			overlay_indices.clear();
+		}
 	}
 
 	SDL_Renderer* CreateRenderer()
 	{
 		SDL_Init(SDL_INIT_VIDEO);
 
+		redraw_event_type = SDL_RegisterEvents(1);
+		if (redraw_event_type == 0) std::cout << "Failed to register redraw event: " << SDL_GetError() << '\n';
+
 		SDL_Rect display_bounds{ 0, 0, 1920, 1080 };
 		if (!SDL_GetDisplayBounds(SDL_GetPrimaryDisplay(), &display_bounds))
 			std::cout << "Failed to get primary display bounds: " << SDL_GetError() << '\n';
@@ -76,35 +128,59 @@ namespace Renderer
 	SDL_Window* GetWindow() { return window; }
 	SDL_Renderer* GetRenderer() { return renderer; }
 
+	int GetMaxTextureSize()
+	{
+		return static_cast<int>(SDL_GetNumberProperty(SDL_GetRendererProperties(renderer), SDL_PROP_RENDERER_MAX_TEXTURE_SIZE_NUMBER, 0));
+	}
+
 	void ToggleFullscreen()
 	{
 		{ SDL_SetWindowFullscreen(window, !(SDL_GetWindowFlags(window) & SDL_WINDOW_FULLSCREEN)); }
 	}
 
+	void RequestRedraw()
+	{
+		const uint32_t event_type = redraw_event_type;
+		if (event_type == 0) return;
+
+		SDL_Event event{};
+		event.type = event_type;
+		SDL_PushEvent(&event);
+	}
+
 	void Update()
 	{
 		if (!Image::canvas) return;
 
-		SDL_SetRenderTarget(renderer, Image::canvas->target);
+		{
+			const Profiler::ScopedTimer timer{ Profiler::Stage::Textures };
+
+			Image::canvas->image.UpdateTextures();
+			for (const auto& image : Image::images)
+			{
+				image->UpdateTextures();
+			}
+		}
 
-		Image::canvas->image.Render(renderer);
-		for (const auto& image : Image::images)
 		{
-			image->Render(renderer);
+			const Profiler::ScopedTimer timer{ Profiler::Stage::Composite };
+
+			// Exports from last frame go first, their copies have had a whole frame to finish on the GPU by now
+			Image::canvas->UpdateExports(renderer);
+			Image::canvas->Composite(renderer);
 		}
 
-		SDL_SetRenderTarget(renderer, nullptr);
+		const Profiler::ScopedTimer timer{ Profiler::Stage::Canvas };
 
 		const SDL_FRect canvas_rect = Image::canvas->image.GetScreenRect();
 		if (checkerboard_texture != nullptr) SDL_RenderTextureTiled(renderer, checkerboard_texture, nullptr, CHECKERBOARD_SCALE, &canvas_rect);
 
-		SDL_RenderTexture(renderer, Image::canvas->target, nullptr, &canvas_rect);
+		// Zoomed out far the canvas is drawn from a downsampled copy, sampling the full target would alias and waste bandwidth
+		Image::canvas->GetDisplayTexture(canvas_rect.w).Render(renderer, canvas_rect);
 
 		// Draw the grid lines if we have zoomed in enough to see them
 		if (zoom > GRID_APPEAR_ZOOM_DEPTH)
 		{
-			SetDrawColor(GRID_COLOR);
-
 			// Used to calculate the index of the first and last pixels of the canvas being rendered, we can then use this to only draw the grid lines that are on screen
 			const float scaling = zoom * Image::canvas->base_scale;
 			SDL_FRect unscaled_canvas_rect = canvas_rect;
@@ -128,27 +204,20 @@ namespace Renderer
 			for (int i = first_vertical_line; i <= last_vertical_line; i++)
 			{
 				const float horizontal_position = static_cast<float>(i) * scaling + offset.x;
-				SDL_RenderLine(renderer, horizontal_position, offset.y, horizontal_position, background_height);
+				AddOverlayRect({ horizontal_position, offset.y, 1.0f, background_height - offset.y }, GRID_COLOR);
 			}
 
 			const float background_width = static_cast<float>(Image::canvas->image.GetWidth()) * scaling + offset.x;
 			for (int i = first_horizontal_line; i <= last_horizontal_line; i++)
 			{
 				const float vertical_position = static_cast<float>(i) * scaling + offset.y;
-				SDL_RenderLine(renderer, offset.x, vertical_position, background_width, vertical_position);
+				AddOverlayRect({ offset.x, vertical_position, background_width - offset.x, 1.0f }, GRID_COLOR);
 			}
 		}
 
-		if (Image::IsSelectionValid())
-		{
-			SetDrawColor(SELECTION_COLOR);
-
-			const auto& selected_image = Image::GetSelection();
-			const SDL_FRect selection_rect = selected_image->GetScreenRect();
-			if (!SDL_RenderRect(renderer, &selection_rect)) std::cout << "Failed to render selection rect: " << SDL_GetError() << '\n';
-		}
+		if (Image::IsSelectionValid()) AddOverlayOutline(Image::GetSelection()->GetScreenRect(), SELECTION_COLOR);
 
-		SetDrawColor(BACKGROUND_COLOR);
+		DrawOverlay();
 	}
 
 	void Exit()
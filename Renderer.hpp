@@ -21,8 +21,12 @@ namespace Renderer
 
 	SDL_Window* GetWindow();
 	SDL_Renderer* GetRenderer();
+	int GetMaxTextureSize();
 	void ToggleFullscreen();
 
+	// Can be called from any thread. Wakes the main loop up when it is waiting for input, so finished work shows up right away
+	void RequestRedraw();
+
 	void Update();
 
 	void Exit();
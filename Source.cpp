@@ -1,44 +1,84 @@
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <optional>
 
 #include <SDL3/SDL_init.h>
 #include <SDL3/SDL_render.h>
+#include <SDL3/SDL_timer.h>
 
 #include "Fonts.hpp"
 #include "Image.hpp"
+#include "Profiler.hpp"
 #include "Renderer.hpp"
 #include "UI.hpp"
 
+using namespace std::chrono;
+
 namespace
 {
-	void ProcessEvents(bool& running)
+	// ImGui needs a few frames after input before everything (like hover highlights and auto sized windows) has caught up
+	constexpr int SETTLE_FRAMES{ 3 };
+
+	void ProcessEvent(const SDL_Event& event, bool& running)
 	{
-		SDL_Event event;
-		while (SDL_PollEvent(&event))
+		UI::ProcessEvents(&event);
+
+		switch (event.type)
 		{
-			UI::ProcessEvents(&event);
+		case SDL_EVENT_QUIT:
+			running = false;
+			break;
 
-			switch (event.type)
+		case SDL_EVENT_KEY_DOWN:
+			if (event.key.scancode == SDL_SCANCODE_F11)
 			{
-			case SDL_EVENT_QUIT:
-				running = false;
-				break;
-
-			case SDL_EVENT_KEY_DOWN:
-				if (event.key.scancode == SDL_SCANCODE_F11)
-				{
-					Renderer::ToggleFullscreen();
-				}
-				break;
-
-			case SDL_EVENT_WINDOW_DISPLAY_CHANGED:
-			case SDL_EVENT_WINDOW_DISPLAY_SCALE_CHANGED:
-				UI::UpdateScale();
-				break;
-
-			default:
-				break;
+				Renderer::ToggleFullscreen();
 			}
+			break;
+
+		case SDL_EVENT_WINDOW_DISPLAY_CHANGED:
+		case SDL_EVENT_WINDOW_DISPLAY_SCALE_CHANGED:
+			UI::UpdateScale();
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	// Returns whether there were any events. With a timeout it waits that many milliseconds for the first one, -1 waits until there is one
+	bool ProcessEvents(bool& running, const int timeout)
+	{
+		SDL_Event event;
+		bool has_event;
+		{
+			const Profiler::ScopedTimer timer{ Profiler::Stage::Waiting };
+			has_event = timeout != 0 ? SDL_WaitEventTimeout(&event, timeout) : SDL_PollEvent(&event);
+		}
+		if (!has_event) return false;
+
+		const Profiler::ScopedTimer timer{ Profiler::Stage::Events };
+
+		ProcessEvent(event, running);
+		while (SDL_PollEvent(&event)) ProcessEvent(event, running);
+		return true;
+	}
+
+	// How long the loop can sleep for when there is no input, 0 draws right away
+	int GetWaitTimeout(const int settle_frames, const std::optional<milliseconds>& next_clock_tick)
+	{
+		if (!UI::frame_settings.idle || settle_frames > 0) return 0;
+
+		int timeout = UI::GetIdleTimeout();
+		if (next_clock_tick)
+		{
+			// Waking just after the second starts, not just before it
+			const int clock_timeout = static_cast<int>(next_clock_tick->count()) + 1;
+			timeout = timeout < 0 ? clock_timeout : std::min<int>(timeout, clock_timeout);
 		}
+
+		return timeout;
 	}
 }
 
@@ -57,9 +97,14 @@ int main(int, char* [])
 	UI::Setup();
 
 	bool running = true;
+	int settle_frames = SETTLE_FRAMES;
+	std::optional<milliseconds> next_clock_tick;
 	do
 	{
-		ProcessEvents(running);
+		// Idle frames sleep until there is input, a worker finished something, or a live clock ticks
+		const steady_clock::time_point frame_start = steady_clock::now();
+		if (ProcessEvents(running, GetWaitTimeout(settle_frames, next_clock_tick))) settle_frames = SETTLE_FRAMES;
+		else if (settle_frames > 0) settle_frames--;
 
 		if (!SDL_RenderClear(renderer))
 		{
@@ -67,13 +112,34 @@ int main(int, char* [])
 			continue;
 		}
 
+		next_clock_tick = Image::UpdateLiveClocks();
 		Renderer::Update();
 		UI::Update(renderer);
 
-		if (!SDL_RenderPresent(renderer)) std::cout << "Failed to present renderer: " << SDL_GetError() << '\n';
+		{
+			const Profiler::ScopedTimer timer{ Profiler::Stage::Present };
+			if (!SDL_RenderPresent(renderer)) std::cout << "Failed to present renderer: " << SDL_GetError() << '\n';
+		}
+
+		// Vsync already limits the frame rate, the cap is for going lower than that
+		if (UI::frame_settings.max_fps > 0)
+		{
+			const nanoseconds frame_time = duration_cast<nanoseconds>(1s) / UI::frame_settings.max_fps;
+			const nanoseconds elapsed = steady_clock::now() - frame_start;
+			if (elapsed < frame_time)
+			{
+				const Profiler::ScopedTimer timer{ Profiler::Stage::Waiting };
+				SDL_DelayPrecise(static_cast<uint64_t>((frame_time - elapsed).count()));
+			}
+		}
+
+		Profiler::EndFrame();
 
 	} while (running);
 
+	// Exports started on the last frame are still waiting for their readback, they'd be gone with the canvas before the export queue ever saw them
+	if (Image::canvas) Image::canvas->UpdateExports(renderer);
+
 	Image::images.clear();
 	Image::canvas.reset();
 
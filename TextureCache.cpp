@@ -0,0 +1,181 @@
+#include "TextureCache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <format>
+#include <unordered_map>
+
+#include <SDL3/SDL_render.h>
+
+#include "ImageResize.hpp"
+#include "Profiler.hpp"
+#include "Renderer.hpp"
+#include "ThreadPool.hpp"
+
+namespace TextureCache
+{
+	struct MipState
+	{
+		std::atomic<bool> cancelled{ false };
+		std::atomic<bool> finished{ false };
+
+		// Only touched by the worker until finished is set, after that only by the main thread
+		std::vector<ImageCache::Pixels> levels;
+		AlphaMask alpha_mask;
+	};
+
+	namespace
+	{
+		// Mip levels stop once they fit in this, it is about the size of a thumbnail in the image items list
+		constexpr int MIN_MIP_SIZE{ 64 };
+
+		// Halving with a box filter is a plain 2x2 average, weighing by alpha keeps transparent edges from darkening
+		constexpr ImageResize::Settings MIP_RESIZE_SETTINGS{ ImageResize::Quality::Fast, false, true };
+
+		// Textures that are gone leave their entry behind, those get cleared out whenever the map doubles in size
+		constexpr size_t MIN_SWEEP_SIZE{ 64 };
+
+		// Only used to tell textures apart, so one counter for all of them is enough
+		uint64_t next_generation{ 0 };
+
+		std::unordered_map<std::string, std::weak_ptr<Texture>> textures;
+		size_t sweep_size{ MIN_SWEEP_SIZE };
+
+		// Runs on the thread pool, the state is shared so the texture can be destroyed while this is still running
+		void GenerateMips(const std::shared_ptr<MipState> state, const std::shared_ptr<const ImageCache::Pixels> pixels)
+		{
+			// Reads every pixel just like the first level does, so it is made here instead of on the main thread
+			state->alpha_mask = AlphaMask{ *pixels };
+
+			const ImageCache::Pixels* previous = pixels.get();
+			while (std::max<int>(previous->width, previous->height) > MIN_MIP_SIZE && !state->cancelled)
+			{
+				ImageCache::Pixels level{ std::max<int>(previous->width / 2, 1), std::max<int>(previous->height / 2, 1) };
+				level.data.resize(static_cast<size_t>(level.width) * static_cast<size_t>(level.height) * 4);
+
+				if (!ImageResize::Resize(previous->data.data(), previous->width, previous->height, level.data.data(), level.width, level.height, MIP_RESIZE_SETTINGS)) break;
+
+				state->levels.push_back(std::move(level));
+				previous = &state->levels.back();
+			}
+
+			state->finished = true;
+			Renderer::RequestRedraw();
+		}
+
+		void SweepExpired()
+		{
+			if (textures.size() < sweep_size) return;
+
+			std::erase_if(textures, [](const auto& entry) { return entry.second.expired(); });
+			sweep_size = std::max<size_t>(MIN_SWEEP_SIZE, textures.size() * 2);
+		}
+	}
+
+	Texture::Texture(std::shared_ptr<const ImageCache::Pixels> new_pixels) : pixels{ std::move(new_pixels) }, generation{ ++next_generation }
+	{
+		// Without a renderer only the pixels are kept, the CPU compositor is all that draws them
+		if (Renderer::GetRenderer() == nullptr)
+		{
+			valid = true;
+			return;
+		}
+
+		const Profiler::ScopedTimer timer{ Profiler::Stage::Upload };
+		texture = Renderer::TiledTexture{ pixels->data.data(), pixels->width, pixels->height };
+		valid = texture.IsValid();
+		if (!valid) return;
+
+		// Textures without mip levels are small enough that their mask is made right away
+		if (std::max<int>(pixels->width, pixels->height) <= MIN_MIP_SIZE) alpha_mask = AlphaMask{ *pixels };
+		else StartMipGeneration();
+	}
+
+	Texture::~Texture()
+	{
+		if (mip_generation != nullptr) mip_generation->cancelled = true;
+	}
+
+	void Texture::UpdateMips()
+	{
+		if (mip_generation == nullptr || !mip_generation->finished) return;
+
+		const Profiler::ScopedTimer timer{ Profiler::Stage::Upload };
+
+		mip_textures.clear();
+		for (const ImageCache::Pixels& level : mip_generation->levels)
+		{
+			Renderer::TiledTexture level_texture{ level.data.data(), level.width, level.height };
+			if (!level_texture.IsValid()) break;
+
+			mip_textures.push_back(std::move(level_texture));
+		}
+
+		alpha_mask = std::move(mip_generation->alpha_mask);
+
+		// Smaller views might draw from a different level now
+		generation = ++next_generation;
+		mip_generation.reset();
+	}
+
+	const Renderer::TiledTexture& Texture::Get(const float draw_width) const
+	{
+		return Renderer::SelectMipLevel(texture, mip_textures, draw_width);
+	}
+
+	SDL_Texture* Texture::GetPreview(const float draw_width) const
+	{
+		SDL_Texture* preview = texture.GetSingleTexture();
+		for (const Renderer::TiledTexture& level : mip_textures)
+		{
+			if (preview != nullptr && static_cast<float>(level.GetWidth()) < draw_width) break;
+			if (SDL_Texture* single_texture = level.GetSingleTexture()) preview = single_texture;
+		}
+
+		return preview;
+	}
+
+	void Texture::StartMipGeneration()
+	{
+		mip_generation = std::make_shared<MipState>();
+		ThreadPool::Submit([state = mip_generation, pixels = pixels] { GenerateMips(state, pixels); });
+	}
+
+	std::string MakeImageKey(const ImageCache::Key& key)
+	{
+		return std::format("image|{}|{}|{}|{}x{}|{}{}{}", key.path, key.modified, key.file_size, key.width, key.height,
+			static_cast<int>(key.resize_settings.quality), static_cast<int>(key.resize_settings.srgb), static_cast<int>(key.resize_settings.premultiply_alpha));
+	}
+
+	std::string MakeTextKey(const std::filesystem::path& font_path, const float line_height, const std::string& text, const uint32_t text_color, const uint32_t bg_color)
+	{
+		// The text goes last, so whatever characters it has can't be mistaken for one of the other fields
+		return std::format("text|{}|{:08X}|{:08X}|{:08X}|{}", font_path.generic_string(), std::bit_cast<uint32_t>(line_height), text_color, bg_color, text);
+	}
+
+	Handle Find(const std::string& key)
+	{
+		const auto found = textures.find(key);
+		return found != textures.end() ? found->second.lock() : nullptr;
+	}
+
+	Handle Get(const std::string& key, const std::function<std::shared_ptr<const ImageCache::Pixels>()>& create)
+	{
+		if (Handle texture = Find(key)) return texture;
+
+		Handle texture = Create(create());
+		if (texture == nullptr || !texture->IsValid()) return texture;
+
+		textures.insert_or_assign(key, texture);
+		SweepExpired();
+
+		return texture;
+	}
+
+	Handle Create(std::shared_ptr<const ImageCache::Pixels> pixels)
+	{
+		if (pixels == nullptr) return nullptr;
+		return std::make_shared<Texture>(std::move(pixels));
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AlphaMask.hpp"
+#include "ImageCache.hpp"
+#include "TiledTexture.hpp"
+
+struct SDL_Texture;
+
+// Textures shared by every layer showing the same pixels, like a logo added twice or a duplicated text.
+// Keys describe what the pixels were made from, so equal keys always mean equal pixels and the texture (and its CPU copy) only exists once
+namespace TextureCache
+{
+	struct MipState; // Shared between a texture and the worker downsampling it
+
+	// Layers share these, so the color of a layer has to be applied right before drawing instead of being set on the texture
+	class Texture
+	{
+	public:
+		// Uploads the pixels and starts making the mip levels on the thread pool. Without a renderer only the pixels are kept
+		explicit Texture(std::shared_ptr<const ImageCache::Pixels> pixels);
+
+		Texture(Texture&) = delete;
+		Texture(Texture&&) = delete;
+		Texture& operator=(Texture&) = delete;
+		Texture& operator=(Texture&&) = delete;
+
+		~Texture();
+
+		// Uploads the mip levels once they are done, so it must be called from the main thread. Every layer sharing this can call it
+		void UpdateMips();
+
+		// Returns the smallest mip level that is still at least draw_width wide, so small views don't sample the full resolution texture
+		[[nodiscard]] const Renderer::TiledTexture& Get(float draw_width) const;
+
+		// Same idea, but only levels that fit in a single texture qualify, for ImGui. Can be nullptr for huge images without mip levels (yet)
+		[[nodiscard]] SDL_Texture* GetPreview(float draw_width) const;
+
+		// Made on the thread pool together with the mip levels for bigger textures, empty until then (and without a renderer)
+		[[nodiscard]] const AlphaMask& GetAlphaMask() const { return alpha_mask; }
+
+		[[nodiscard]] bool IsValid() const { return valid; }
+		[[nodiscard]] const std::shared_ptr<const ImageCache::Pixels>& GetPixels() const { return pixels; }
+
+		// Changes whenever what this draws changes (like when the mip levels arrive), so the canvas knows what to redraw
+		[[nodiscard]] uint64_t GetGeneration() const { return generation; }
+
+	private:
+		void StartMipGeneration();
+
+		std::shared_ptr<const ImageCache::Pixels> pixels;
+		Renderer::TiledTexture texture;
+		bool valid{ false };
+		uint64_t generation{ 0 };
+
+		// Every level is half the size of the one before it, the last one (at most MIN_MIP_SIZE) doubles as the thumbnail
+		std::vector<Renderer::TiledTexture> mip_textures;
+		std::shared_ptr<MipState> mip_generation;
+
+		AlphaMask alpha_mask;
+	};
+
+	using Handle = std::shared_ptr<Texture>;
+
+	// An image file as it is on disk, at the resolution and with the resize settings in the key
+	[[nodiscard]] std::string MakeImageKey(const ImageCache::Key& key);
+	[[nodiscard]] std::string MakeTextKey(const std::filesystem::path& font_path, float line_height, const std::string& text, uint32_t text_color, uint32_t bg_color);
+
+	// nullptr when nothing holds a texture for the key right now
+	[[nodiscard]] Handle Find(const std::string& key);
+
+	// Returns the texture that is already alive for the key, otherwise one made from the pixels create returns (nullptr if that does).
+	// Textures are gone as soon as the last layer using them lets go, everything here is main thread only
+	[[nodiscard]] Handle Get(const std::string& key, const std::function<std::shared_ptr<const ImageCache::Pixels>()>& create);
+
+	// For textures nothing else could have the same pixels as, they still get their mip levels like the shared ones
+	[[nodiscard]] Handle Create(std::shared_ptr<const ImageCache::Pixels> pixels);
+}
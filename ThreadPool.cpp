@@ -0,0 +1,163 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ThreadPool
+{
+	namespace
+	{
+		class Pool
+		{
+		public:
+			Pool()
+			{
+				// Leave one core for the main thread, it always helps out in ParallelFor anyway
+				const size_t worker_count = std::max<size_t>(std::thread::hardware_concurrency(), 2) - 1;
+				for (size_t i = 0; i < worker_count; i++)
+				{
+					workers.emplace_back([this](const std::stop_token& stop_token) { WorkerLoop(stop_token); });
+				}
+			}
+
+			~Pool()
+			{
+				{
+					std::lock_guard lock{ mutex };
+					for (auto& worker : workers) worker.request_stop();
+				}
+				condition.notify_all();
+			}
+
+			void Submit(std::function<void()> task)
+			{
+				{
+					std::lock_guard lock{ mutex };
+					tasks.push_back(std::move(task));
+				}
+				condition.notify_one();
+			}
+
+			[[nodiscard]] size_t GetWorkerCount() const { return workers.size(); }
+
+		private:
+			void WorkerLoop(const std::stop_token& stop_token)
+			{
+				while (true)
+				{
+					std::function<void()> task;
+					{
+						std::unique_lock lock{ mutex };
+						condition.wait(lock, [this, &stop_token] { return !tasks.empty() || stop_token.stop_requested(); });
+						if (stop_token.stop_requested()) return;
+
+						task = std::move(tasks.front());
+						tasks.pop_front();
+					}
+
+					task();
+				}
+			}
+
+			std::mutex mutex;
+			std::condition_variable condition;
+			std::deque<std::function<void()>> tasks;
+
+			// Declared last so the threads are joined before the rest gets destroyed
+			std::vector<std::jthread> workers;
+		};
+
+		std::atomic<size_t> thread_limit{ 0 };
+
+		Pool& GetPool()
+		{
+			static Pool pool;
+			return pool;
+		}
+
+		struct ParallelForState
+		{
+			ParallelForState(const size_t count, const std::function<void(size_t)>& function) : count{ count }, function{ function }
+			{}
+
+			// Returns true when this call finished the last index
+			bool RunIndices()
+			{
+				size_t finished = 0;
+				for (size_t i = next_index++; i < count; i = next_index++)
+				{
+					function(i);
+					finished++;
+				}
+
+				if (finished == 0) return false;
+				return (finished_count += finished) == count;
+			}
+
+			const size_t count;
+			const std::function<void(size_t)>& function;
+
+			std::atomic<size_t> next_index{ 0 };
+			std::atomic<size_t> finished_count{ 0 };
+
+			std::mutex mutex;
+			std::condition_variable condition;
+			bool done{ false };
+		};
+	}
+
+	size_t GetThreadCount()
+	{
+		const size_t thread_count = GetPool().GetWorkerCount() + 1;
+		const size_t limit = thread_limit;
+		return limit > 0 ? std::min<size_t>(limit, thread_count) : thread_count;
+	}
+
+	void SetThreadLimit(const size_t count)
+	{
+		thread_limit = count;
+	}
+
+	void Submit(std::function<void()> task)
+	{
+		GetPool().Submit(std::move(task));
+	}
+
+	void ParallelFor(const size_t count, const std::function<void(size_t)>& function)
+	{
+		if (count == 0) return;
+		if (count == 1)
+		{
+			function(0);
+			return;
+		}
+
+		// The function reference stays valid because we don't return before every index is finished,
+		// helpers that start after that only see that there's nothing left to do
+		const auto state = std::make_shared<ParallelForState>(count, function);
+
+		const size_t helper_count = std::min<size_t>(count - 1, GetThreadCount() - 1);
+		for (size_t i = 0; i < helper_count; i++)
+		{
+			GetPool().Submit([state]
+				{
+					if (!state->RunIndices()) return;
+
+					std::lock_guard lock{ state->mutex };
+					state->done = true;
+					state->condition.notify_all();
+				});
+		}
+
+		if (state->RunIndices()) return;
+
+		std::unique_lock lock{ state->mutex };
+		state->condition.wait(lock, [&state] { return state->done; });
+	}
+}
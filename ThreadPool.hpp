@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// A small pool of worker threads shared by everything that wants to split work up (resizing, encoding, etc.)
+namespace ThreadPool
+{
+	// Worker threads plus the calling thread, since ParallelFor also runs work on the caller
+	[[nodiscard]] size_t GetThreadCount();
+
+	// Uses at most count threads (including the caller) from now on, 0 goes back to all of them. For measuring how work scales with the thread count
+	void SetThreadLimit(size_t count);
+
+	// Runs the task on a worker at some point, doesn't wait for it
+	void Submit(std::function<void()> task);
+
+	// Calls function for every index in [0, count) spread out over the workers and the calling thread, returns when all of them are done.
+	// The caller keeps taking indices itself, so this doesn't deadlock when called from a worker while all the others are busy
+	void ParallelFor(size_t count, const std::function<void(size_t)>& function);
+}
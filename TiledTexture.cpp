@@ -0,0 +1,301 @@
+#include "TiledTexture.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <SDL3/SDL_intrin.h>
+#include <SDL3/SDL_render.h>
+
+#include "Profiler.hpp"
+#include "Renderer.hpp"
+
+namespace Renderer
+{
+	namespace
+	{
+		// Input and output can be the same, every block is loaded before it gets stored
+		void SwapRedAndBlue(const uint8_t* input, uint8_t* output, const size_t pixel_count)
+		{
+			size_t i = 0;
+
+#ifdef SDL_SSE2_INTRINSICS
+			// Red and blue are bytes 0 and 2 of every pixel, shifting them 16 bits both ways swaps them without touching green and alpha
+			const __m128i green_alpha_mask = _mm_set1_epi32(static_cast<int>(0xFF00FF00));
+			for (; i + 4 <= pixel_count; i += 4)
+			{
+				const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + 4 * i));
+				const __m128i red_blue = _mm_andnot_si128(green_alpha_mask, pixels);
+				const __m128i swapped = _mm_or_si128(_mm_slli_epi32(red_blue, 16), _mm_srli_epi32(red_blue, 16));
+
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(output + 4 * i), _mm_or_si128(_mm_and_si128(pixels, green_alpha_mask), swapped));
+			}
+#endif
+
+			for (; i < pixel_count; i++)
+			{
+				const uint8_t red = input[4 * i + 2];
+				const uint8_t green = input[4 * i + 1];
+				const uint8_t blue = input[4 * i];
+				const uint8_t alpha = input[4 * i + 3];
+
+				output[4 * i] = red;
+				output[4 * i + 1] = green;
+				output[4 * i + 2] = blue;
+				output[4 * i + 3] = alpha;
+			}
+		}
+	}
+
+	int GetTileSize()
+	{
+		const int max_texture_size = GetMaxTextureSize();
+		return max_texture_size > 0 ? std::min<int>(max_texture_size, MAX_TILE_SIZE) : MAX_TILE_SIZE;
+	}
+
+	TiledTexture::TiledTexture(const void* pixels, const int width, const int height) : width{ width }, height{ height }
+	{
+		if (!CreateTiles(SDL_TEXTUREACCESS_STATIC)) return;
+
+		const uint8_t* pixel_bytes = static_cast<const uint8_t*>(pixels);
+		for (const auto& [texture, rect] : tiles)
+		{
+			// The pitch is the one of the whole image, so SDL can copy the tile straight out of it
+			const uint8_t* tile_start = pixel_bytes + (static_cast<size_t>(rect.y) * static_cast<size_t>(width) + static_cast<size_t>(rect.x)) * 4;
+			if (!SDL_UpdateTexture(texture, nullptr, tile_start, width * 4)) std::cout << "Failed to update tile: " << SDL_GetError() << '\n';
+			else Profiler::Count(Profiler::Counter::BytesUploaded, static_cast<uint64_t>(rect.w) * static_cast<uint64_t>(rect.h) * 4);
+		}
+	}
+
+	TiledTexture TiledTexture::CreateTarget(const int width, const int height)
+	{
+		TiledTexture target;
+		target.width = width;
+		target.height = height;
+		target.CreateTiles(SDL_TEXTUREACCESS_TARGET);
+
+		return target;
+	}
+
+	TiledTexture::TiledTexture(TiledTexture&& tiled_texture) noexcept :
+		tiles{ std::move(tiled_texture.tiles) },
+		width{ tiled_texture.width },
+		height{ tiled_texture.height }
+	{
+		tiled_texture.tiles.clear();
+	}
+
+	TiledTexture& TiledTexture::operator=(TiledTexture&& tiled_texture) noexcept
+	{
+		if (this == &tiled_texture) return *this;
+
+		Destroy();
+
+		tiles = std::move(tiled_texture.tiles);
+		width = tiled_texture.width;
+		height = tiled_texture.height;
+		tiled_texture.tiles.clear();
+
+		return *this;
+	}
+
+	TiledTexture::~TiledTexture()
+	{
+		Destroy();
+	}
+
+	void TiledTexture::Render(SDL_Renderer* renderer, const SDL_FRect& destination) const
+	{
+		const float scale_x = destination.w / static_cast<float>(width);
+		const float scale_y = destination.h / static_cast<float>(height);
+
+		// Filtered tiles clamp at their own edges, which shows up as seams between them when scaled. Nearest filtering has none,
+		// at the cost of blockier scaling. Shrinking mostly draws a mip level that fits in one tile anyway, so this is mainly for zooming in
+		const bool avoid_seams = tiles.size() > 1 && (scale_x != 1.0f || scale_y != 1.0f);
+
+		for (const auto& [texture, rect] : tiles)
+		{
+			const SDL_FRect tile_destination
+			{
+				destination.x + static_cast<float>(rect.x) * scale_x,
+				destination.y + static_cast<float>(rect.y) * scale_y,
+				static_cast<float>(rect.w) * scale_x,
+				static_cast<float>(rect.h) * scale_y
+			};
+
+			SDL_ScaleMode scale_mode = SDL_SCALEMODE_LINEAR;
+			const bool switched = avoid_seams && SDL_GetTextureScaleMode(texture, &scale_mode) && SDL_SetTextureScaleMode(texture, SDL_SCALEMODE_NEAREST);
+
+			SDL_RenderTexture(renderer, texture, nullptr, &tile_destination);
+			if (switched) SDL_SetTextureScaleMode(texture, scale_mode);
+		}
+	}
+
+	TiledTexture TiledTexture::Copy(SDL_Renderer* renderer) const
+	{
+		TiledTexture copy = CreateTarget(width, height);
+		if (!copy.IsValid()) return copy;
+
+		SDL_Texture* previous_target = SDL_GetRenderTarget(renderer);
+
+		// Same size means the same tiles, so every tile is copied 1:1
+		SetBlendMode(SDL_BLENDMODE_NONE);
+		for (size_t i = 0; i < tiles.size(); i++)
+		{
+			SDL_SetRenderTarget(renderer, copy.tiles.at(i).texture);
+			SDL_RenderTexture(renderer, tiles.at(i).texture, nullptr, nullptr);
+		}
+		SetBlendMode(SDL_BLENDMODE_BLEND);
+
+		SDL_SetRenderTarget(renderer, previous_target);
+		return copy;
+	}
+
+	Readback TiledTexture::ReadPixels(SDL_Renderer* renderer) const
+	{
+		if (!IsValid()) return {};
+
+		SDL_Texture* previous_target = SDL_GetRenderTarget(renderer);
+
+		// A single tile can be handed over as is, only needing a swizzle in place on backends that read back BGRA
+		if (tiles.size() == 1)
+		{
+			SDL_SetRenderTarget(renderer, tiles.front().texture);
+			SDL_Surface* surface = SDL_RenderReadPixels(renderer, nullptr);
+			SDL_SetRenderTarget(renderer, previous_target);
+
+			if (surface == nullptr)
+			{
+				std::cout << "Failed to read tile pixels: " << SDL_GetError() << '\n';
+				return {};
+			}
+
+			const bool tightly_packed = surface->pitch == 4 * surface->w;
+			if (tightly_packed && surface->format == SDL_PIXELFORMAT_RGBA32) return Readback{ surface };
+
+			if (tightly_packed && surface->format == SDL_PIXELFORMAT_BGRA32)
+			{
+				uint8_t* pixels = static_cast<uint8_t*>(surface->pixels);
+				SwapRedAndBlue(pixels, pixels, static_cast<size_t>(surface->w) * static_cast<size_t>(surface->h));
+				return Readback{ surface };
+			}
+
+			SDL_Surface* converted_surface = SDL_ConvertSurface(surface, SDL_PIXELFORMAT_RGBA32);
+			SDL_DestroySurface(surface);
+
+			if (converted_surface == nullptr) std::cout << "Failed to convert tile pixels: " << SDL_GetError() << '\n';
+			return Readback{ converted_surface };
+		}
+
+		SDL_Surface* output = SDL_CreateSurface(width, height, SDL_PIXELFORMAT_RGBA32);
+		if (output == nullptr)
+		{
+			std::cout << "Failed to create readback surface: " << SDL_GetError() << '\n';
+			return {};
+		}
+
+		Readback readback{ output };
+		for (const auto& [texture, rect] : tiles)
+		{
+			SDL_SetRenderTarget(renderer, texture);
+
+			SDL_Surface* surface = SDL_RenderReadPixels(renderer, nullptr);
+			if (surface == nullptr)
+			{
+				std::cout << "Failed to read tile pixels: " << SDL_GetError() << '\n';
+				readback = {};
+				break;
+			}
+
+			// The tiles have to be stitched together anyway, so the swizzle happens during that copy
+			uint8_t* output_start = static_cast<uint8_t*>(output->pixels) + static_cast<size_t>(rect.y) * static_cast<size_t>(output->pitch) + static_cast<size_t>(rect.x) * 4;
+			if (surface->format == SDL_PIXELFORMAT_RGBA32 || surface->format == SDL_PIXELFORMAT_BGRA32)
+			{
+				for (int row = 0; row < rect.h; row++)
+				{
+					const uint8_t* source_row = static_cast<const uint8_t*>(surface->pixels) + static_cast<size_t>(row) * static_cast<size_t>(surface->pitch);
+					uint8_t* output_row = output_start + static_cast<size_t>(row) * static_cast<size_t>(output->pitch);
+
+					if (surface->format == SDL_PIXELFORMAT_BGRA32) SwapRedAndBlue(source_row, output_row, static_cast<size_t>(rect.w));
+					else std::memcpy(output_row, source_row, static_cast<size_t>(rect.w) * 4);
+				}
+			}
+			else if (!SDL_ConvertPixels(rect.w, rect.h, surface->format, surface->pixels, surface->pitch, SDL_PIXELFORMAT_RGBA32, output_start, output->pitch))
+			{
+				std::cout << "Failed to convert tile pixels: " << SDL_GetError() << '\n';
+				readback = {};
+			}
+
+			SDL_DestroySurface(surface);
+			if (!readback.IsValid()) break;
+		}
+
+		SDL_SetRenderTarget(renderer, previous_target);
+		return readback;
+	}
+
+	void TiledTexture::SetColorMod(const uint8_t red, const uint8_t green, const uint8_t blue) const
+	{
+		for (const Tile& tile : tiles) SDL_SetTextureColorMod(tile.texture, red, green, blue);
+	}
+
+	void TiledTexture::SetAlphaMod(const uint8_t alpha) const
+	{
+		for (const Tile& tile : tiles) SDL_SetTextureAlphaMod(tile.texture, alpha);
+	}
+
+	void TiledTexture::SetScaleMode(const SDL_ScaleMode scale_mode) const
+	{
+		for (const Tile& tile : tiles) SDL_SetTextureScaleMode(tile.texture, scale_mode);
+	}
+
+	void TiledTexture::SetBlendMode(const SDL_BlendMode blend_mode) const
+	{
+		for (const Tile& tile : tiles) SDL_SetTextureBlendMode(tile.texture, blend_mode);
+	}
+
+	bool TiledTexture::CreateTiles(const int texture_access)
+	{
+		if (width <= 0 || height <= 0) return false;
+
+		SDL_Renderer* renderer = GetRenderer();
+		const int tile_size = GetTileSize();
+
+		for (int tile_y = 0; tile_y < height; tile_y += tile_size) for (int tile_x = 0; tile_x < width; tile_x += tile_size)
+		{
+			const SDL_Rect rect{ tile_x, tile_y, std::min<int>(tile_size, width - tile_x), std::min<int>(tile_size, height - tile_y) };
+
+			SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, static_cast<SDL_TextureAccess>(texture_access), rect.w, rect.h);
+			if (texture == nullptr)
+			{
+				std::cout << "Failed to create tile: " << SDL_GetError() << '\n';
+				Destroy();
+				return false;
+			}
+
+			SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+			tiles.push_back({ texture, rect });
+			Profiler::Count(Profiler::Counter::TexturesCreated);
+		}
+
+		return true;
+	}
+
+	void TiledTexture::Destroy()
+	{
+		for (const Tile& tile : tiles) SDL_DestroyTexture(tile.texture);
+		tiles.clear();
+	}
+
+	const TiledTexture& SelectMipLevel(const TiledTexture& base, const std::vector<TiledTexture>& levels, const float draw_width)
+	{
+		const TiledTexture* selected = &base;
+		for (const TiledTexture& level : levels)
+		{
+			if (static_cast<float>(level.GetWidth()) < draw_width) break;
+			selected = &level;
+		}
+
+		return *selected;
+	}
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <SDL3/SDL_blendmode.h>
+#include <SDL3/SDL_rect.h>
+#include <SDL3/SDL_surface.h>
+
+struct SDL_Renderer;
+struct SDL_Texture;
+
+namespace Renderer
+{
+	// Tiles are at most this big, or the renderer's max texture size if that is smaller
+	constexpr int MAX_TILE_SIZE{ 2048 };
+	int GetTileSize();
+
+	// Tightly packed RGBA pixels read back from the GPU. Owns the surface they were read into, so they never have to be copied out of it
+	class Readback
+	{
+	public:
+		Readback() = default;
+		explicit Readback(SDL_Surface* surface) : surface{ surface } {}
+
+		[[nodiscard]] bool IsValid() const { return surface != nullptr; }
+		[[nodiscard]] const uint8_t* GetData() const { return IsValid() ? static_cast<const uint8_t*>(surface->pixels) : nullptr; }
+		[[nodiscard]] int GetWidth() const { return IsValid() ? surface->w : 0; }
+		[[nodiscard]] int GetHeight() const { return IsValid() ? surface->h : 0; }
+
+	private:
+		struct SurfaceDeleter
+		{
+			void operator()(SDL_Surface* surface) const { SDL_DestroySurface(surface); }
+		};
+
+		// The format of the surface can still say BGRA when it was swizzled in place, the pixels are always RGBA
+		std::unique_ptr<SDL_Surface, SurfaceDeleter> surface;
+	};
+
+	// A texture split up into tiles, so it can be bigger than the max texture size of the GPU
+	class TiledTexture
+	{
+	public:
+		struct Tile
+		{
+			SDL_Texture* texture{ nullptr };
+			SDL_Rect rect{};
+		};
+
+		TiledTexture() = default;
+
+		// Uploads tightly packed RGBA pixels
+		TiledTexture(const void* pixels, int width, int height);
+		static TiledTexture CreateTarget(int width, int height);
+
+		TiledTexture(TiledTexture&) = delete;
+		TiledTexture(TiledTexture&& tiled_texture) noexcept;
+		TiledTexture& operator=(TiledTexture&) = delete;
+		TiledTexture& operator=(TiledTexture&& tiled_texture) noexcept;
+
+		~TiledTexture();
+
+		// Draws the whole texture stretched over destination. Textures with more than one tile are drawn with nearest filtering when scaled, so there are no seams between the tiles
+		void Render(SDL_Renderer* renderer, const SDL_FRect& destination) const;
+
+		// Copies the tiles into a new target on the GPU, so this one can keep changing while the copy waits to be read back
+		[[nodiscard]] TiledTexture Copy(SDL_Renderer* renderer) const;
+
+		// Reads all tiles back, only works on targets. This stalls until the GPU is done drawing into them
+		[[nodiscard]] Readback ReadPixels(SDL_Renderer* renderer) const;
+
+		void SetColorMod(uint8_t red, uint8_t green, uint8_t blue) const;
+		void SetAlphaMod(uint8_t alpha) const;
+		void SetScaleMode(SDL_ScaleMode scale_mode) const;
+		void SetBlendMode(SDL_BlendMode blend_mode) const;
+
+		[[nodiscard]] bool IsValid() const { return !tiles.empty(); }
+		[[nodiscard]] int GetWidth() const { return width; }
+		[[nodiscard]] int GetHeight() const { return height; }
+
+		// Tiles are stored row by row
+		[[nodiscard]] const std::vector<Tile>& GetTiles() const { return tiles; }
+
+		// Only textures that fit in a single tile can be handed to things that expect a single texture, like ImGui
+		[[nodiscard]] SDL_Texture* GetSingleTexture() const { return tiles.size() == 1 ? tiles.front().texture : nullptr; }
+
+	private:
+		bool CreateTiles(int texture_access);
+		void Destroy();
+
+		std::vector<Tile> tiles;
+		int width{ 0 };
+		int height{ 0 };
+	};
+
+	// Returns the smallest level in the chain that is at least draw_width wide, the base texture comes before all the levels
+	[[nodiscard]] const TiledTexture& SelectMipLevel(const TiledTexture& base, const std::vector<TiledTexture>& levels, float draw_width);
+}
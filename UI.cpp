@@ -1,9 +1,13 @@
 #include "UI.hpp"
 
+#include <algorithm>
 #include <array>
 #include <chrono>
 #include <filesystem>
+#include <format>
 #include <iostream>
+#include <string>
+#include <vector>
 
 #include <portable-file-dialogs.h>
 #undef min
@@ -18,7 +22,11 @@
 #include <SDL3/SDL_render.h>
 #include <SDL3/SDL_video.h>
 
+#include "History.hpp"
 #include "Image.hpp"
+#include "Layout.hpp"
+#include "Profiler.hpp"
+#include "Project.hpp"
 #include "Renderer.hpp"
 
 
@@ -33,6 +41,16 @@ namespace UI
 		constexpr float START_SELECT_IMAGE_SCALE{ 12.0f };
 
 		constexpr float UI_SCALING_FACTOR{ 1.25f };
+
+		// Progress bars don't need to move any smoother than this, finished work wakes the main loop right away anyway
+		constexpr int PROGRESS_REFRESH_MS{ 100 };
+
+		// About half of the time the text cursor is shown for
+		constexpr int CURSOR_BLINK_MS{ 400 };
+
+		constexpr int MAX_FRAME_RATE_CAP{ 240 };
+
+		bool show_profiler{ false };
 		float ui_scale{ 1.0f };
 
 		void SelectedTextMenu()
@@ -66,6 +84,248 @@ namespace UI
 			return { new_width, new_height };
 		}
 
+		// The selected format goes first, so the save dialog starts with it
+		std::vector<std::string> GetExportFilters(const ImageExport::Format selected_format)
+		{
+			std::vector<std::string> filters;
+			for (size_t i = 0; i < ImageExport::FORMAT_NAMES.size(); i++)
+			{
+				std::string name = std::string{ ImageExport::FORMAT_NAMES.at(i) } + " image";
+				std::string pattern = std::string{ "*" } + ImageExport::FORMAT_EXTENSIONS.at(i);
+
+				const auto position = static_cast<size_t>(selected_format) == i ? filters.begin() : filters.end();
+				filters.insert(position, { std::move(name), std::move(pattern) });
+			}
+
+			return filters;
+		}
+
+		const std::vector<std::string> LAYOUT_FILTERS{ "Layout", "*.json" };
+		const std::vector<std::string> PROJECT_FILTERS{ "Project", "*.tbp" };
+		const std::vector<std::string> OPEN_LAYOUT_FILTERS{ "Layout or project", "*.json *.tbp", "Layout", "*.json", "Project", "*.tbp" };
+
+		Project::SaveSettings project_settings;
+
+		void OpenLayout()
+		{
+			const std::vector result = pfd::open_file{ "Open layout", "", OPEN_LAYOUT_FILTERS }.result();
+			if (result.empty()) return;
+
+			const std::filesystem::path path{ result.at(0) };
+			if (path.extension() == Project::EXTENSION) Project::Load(path);
+			else if (const std::optional<Json::Value> layout = Json::ReadFile(path)) Layout::Apply(*layout);
+		}
+
+		// Adds the extension when the dialog didn't
+		std::filesystem::path SaveDialog(const char* title, const std::vector<std::string>& filters, const char* extension)
+		{
+			std::filesystem::path result = pfd::save_file{ title, "", filters }.result();
+			if (!result.empty() && !result.has_extension()) result += extension;
+
+			return result;
+		}
+
+		void LayoutMenu()
+		{
+			if (ImGui::BeginMenu("Layout"))
+			{
+				if (ImGui::MenuItem("Open...")) OpenLayout();
+
+				if (ImGui::MenuItem("Save layout..."))
+				{
+					const std::filesystem::path result = SaveDialog("Save layout", LAYOUT_FILTERS, ".json");
+					if (!result.empty()) Layout::Save(result);
+				}
+
+				if (ImGui::MenuItem("Save project..."))
+				{
+					const std::filesystem::path result = SaveDialog("Save project", PROJECT_FILTERS, Project::EXTENSION);
+					if (!result.empty()) Project::Save(result, project_settings);
+				}
+
+				ImGui::Separator();
+				ImGui::MenuItem("Embed images in projects", nullptr, &project_settings.embed_images);
+				ImGui::MenuItem("Embed glyphs in projects", nullptr, &project_settings.embed_glyphs);
+
+				ImGui::EndMenu();
+			}
+		}
+
+		void EditMenu()
+		{
+			if (ImGui::BeginMenu("Edit"))
+			{
+				if (ImGui::MenuItem("Undo", "Ctrl+Z", false, History::CanUndo())) History::Undo();
+				if (ImGui::MenuItem("Redo", "Ctrl+Y", false, History::CanRedo())) History::Redo();
+
+				ImGui::EndMenu();
+			}
+		}
+
+		void ViewMenu()
+		{
+			if (ImGui::BeginMenu("View"))
+			{
+				ImGui::MenuItem("Only redraw when needed", nullptr, &frame_settings.idle);
+				if (ImGui::MenuItem("Profiler", nullptr, &show_profiler)) Profiler::SetEnabled(show_profiler);
+				ImGui::SliderInt("Frame rate cap", &frame_settings.max_fps, 0, MAX_FRAME_RATE_CAP, frame_settings.max_fps == 0 ? "Off" : "%d fps", ImGuiSliderFlags_ClampOnInput);
+
+				ImGui::EndMenu();
+			}
+		}
+
+		// Text fields have their own undo, so these only work when not typing in one
+		void HistoryShortcuts()
+		{
+			if (ImGui::GetIO().WantTextInput) return;
+
+			if (ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_Z)) History::Undo();
+			if (ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_Y) || ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiMod_Shift | ImGuiKey_Z)) History::Redo();
+		}
+
+		// Closing it also stops profiling, so the timers cost nothing while nobody looks at them
+		void ProfilerWindow(bool& open)
+		{
+			ImGui::SetNextWindowSize(ImVec2{ 30.0f, 35.0f } * ImGui::GetFontSize(), ImGuiCond_FirstUseEver);
+			if (ImGui::Begin("Profiler", &open))
+			{
+				const Profiler::History& history = Profiler::GetHistory();
+
+				// Oldest first once the history is full
+				const int count = static_cast<int>(history.count);
+				const int offset = history.count == Profiler::HISTORY_SIZE ? static_cast<int>(history.next) : 0;
+
+				std::vector<float> sorted_frames(history.frame_milliseconds.begin(), history.frame_milliseconds.begin() + count);
+				std::ranges::sort(sorted_frames);
+				const auto percentile = [&sorted_frames](const float fraction) { return sorted_frames.empty() ? 0.0f : sorted_frames.at(static_cast<size_t>(fraction * static_cast<float>(sorted_frames.size() - 1))); };
+
+				ImGui::Text("Frame time (ms, without waiting) over %d frames", count);
+				ImGui::Text("p50 %.2f   p95 %.2f   p99 %.2f   max %.2f", percentile(0.5f), percentile(0.95f), percentile(0.99f), percentile(1.0f));
+
+				// Every stage uses the same scale, so they can be compared at a glance
+				const float scale = std::max<float>(percentile(0.99f), 1.0f);
+				const ImVec2 plot_size{ -FLT_MIN, ImGui::GetFontSize() * 2.0f };
+				ImGui::PlotHistogram("##Frame", history.frame_milliseconds.data(), count, offset, "Frame", 0.0f, scale, plot_size);
+
+				ImGui::SeparatorText("Stages");
+				for (size_t i = 0; i < Profiler::STAGE_NAMES.size(); i++)
+				{
+					const std::array<float, Profiler::HISTORY_SIZE>& stage = history.stage_milliseconds.at(i);
+
+					float total = 0.0f;
+					for (int frame = 0; frame < count; frame++) total += stage.at(static_cast<size_t>(frame));
+
+					const std::string label = std::format("{} {:.2f} ms", Profiler::STAGE_NAMES.at(i), count > 0 ? total / static_cast<float>(count) : 0.0f);
+					ImGui::PushID(static_cast<int>(i));
+					ImGui::PlotHistogram("##Stage", stage.data(), count, offset, label.c_str(), 0.0f, scale, plot_size);
+					ImGui::PopID();
+				}
+
+				ImGui::SeparatorText("Counters");
+				if (ImGui::BeginTable("Counters", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp))
+				{
+					ImGui::TableSetupColumn("");
+					ImGui::TableSetupColumn("Last frame");
+					ImGui::TableSetupColumn("Total");
+					ImGui::TableHeadersRow();
+
+					for (size_t i = 0; i < Profiler::COUNTER_NAMES.size(); i++)
+					{
+						ImGui::TableNextRow();
+						ImGui::TableNextColumn();
+						ImGui::TextUnformatted(Profiler::COUNTER_NAMES.at(i));
+						ImGui::TableNextColumn();
+						ImGui::Text("%llu", static_cast<unsigned long long>(history.last_counters.at(i)));
+						ImGui::TableNextColumn();
+						ImGui::Text("%llu", static_cast<unsigned long long>(history.total_counters.at(i)));
+					}
+
+					ImGui::EndTable();
+				}
+			}
+			ImGui::End();
+
+			if (!open) Profiler::SetEnabled(false);
+		}
+
+		// Not modal, so editing can continue while the exports run
+		void ExportsWindow()
+		{
+			const std::vector<std::shared_ptr<ExportQueue::Job>> jobs = ExportQueue::GetJobs();
+			if (jobs.empty()) return;
+
+			ImGui::SetNextWindowSize(ImVec2{ 25.0f, 12.0f } * ImGui::GetFontSize(), ImGuiCond_FirstUseEver);
+			if (ImGui::Begin("Exports"))
+			{
+				for (const auto& job : jobs)
+				{
+					ImGui::PushID(job.get());
+
+					const std::string file_name = std::filesystem::path{ job->path }.filename().string();
+					ImGui::Text("%s (%s, %.0f%%)", file_name.c_str(), ImageExport::FORMAT_NAMES.at(static_cast<size_t>(job->settings.format)), job->scale * 100.0f);
+
+					const ExportQueue::State state = job->state;
+					const float progress = state == ExportQueue::State::Finished ? 1.0f : job->progress.load();
+					// While encoding the bar shows the percentage instead
+					const char* state_name = state == ExportQueue::State::Encoding ? nullptr : ExportQueue::STATE_NAMES.at(static_cast<size_t>(state));
+
+					if (job->IsDone())
+					{
+						ImGui::ProgressBar(progress, { -1.0f, 0.0f }, state_name);
+					}
+					else
+					{
+						ImGui::ProgressBar(progress, { -ImGui::CalcTextSize("Cancel").x - ImGui::GetStyle().FramePadding.x * 2.0f - ImGui::GetStyle().ItemSpacing.x, 0.0f }, state_name);
+						ImGui::SameLine();
+
+						ImGui::BeginDisabled(job->cancelled);
+						if (ImGui::Button("Cancel")) job->cancelled = true;
+						ImGui::EndDisabled();
+					}
+
+					ImGui::PopID();
+				}
+
+				if (ButtonRightAlign("Clear finished")) ExportQueue::ClearFinishedJobs();
+			}
+			ImGui::End();
+		}
+
+		void ExportSettingsUI(ImageExport::Settings& settings)
+		{
+			int format = static_cast<int>(settings.format);
+			if (ImGui::Combo("Format", &format, ImageExport::FORMAT_NAMES.data(), static_cast<int>(ImageExport::FORMAT_NAMES.size())))
+			{
+				settings.format = static_cast<ImageExport::Format>(format);
+			}
+
+			switch (settings.format)
+			{
+			case ImageExport::Format::Png:
+			{
+				// Smaller files take longer to export, mostly matters for really big banners
+				int compression = static_cast<int>(settings.png_compression);
+				if (ImGui::Combo("Compression", &compression, PngWriter::COMPRESSION_NAMES.data(), static_cast<int>(PngWriter::COMPRESSION_NAMES.size())))
+				{
+					settings.png_compression = static_cast<PngWriter::Compression>(compression);
+				}
+				break;
+			}
+
+			case ImageExport::Format::Jpeg:
+				ImGui::SliderInt("Quality", &settings.jpeg_quality, 1, 100, "%d", ImGuiSliderFlags_ClampOnInput);
+				ImGui::TextDisabled("JPEG has no transparency");
+				break;
+
+			case ImageExport::Format::Tga:
+				ImGui::Checkbox("Run length encoding", &settings.tga_rle);
+				break;
+
+			default:
+				break;
+			}
+		}
+
 		void ImageSelection(size_t& i)
 		{
 			const float image_area_height = ITEM_SELECT_IMAGE_SCALE * ImGui::GetFontSize();
@@ -82,7 +342,10 @@ namespace UI
 			const ImVec2 image_area_middle = selectable_origin + ImVec2{ selectable_height / 2.0f, selectable_height / 2.0f };
 			const ImVec2 image_size = GetImageDrawSize(image->GetWidth(), image->GetHeight(), image_area);
 			ImGui::SetCursorPos(image_area_middle - image_size / 2.0f);
-			ImGui::Image(image->GetTexture(), image_size);
+			// Huge images have nothing ImGui can draw until their smaller mip levels are done
+			// Textures are shared between layers, so the tint goes with the draw instead of on the texture
+			if (SDL_Texture* preview = image->GetPreviewTexture(image_size.x)) ImGui::ImageWithBg(preview, image_size, { 0.0f, 0.0f }, { 1.0f, 1.0f }, {}, ImGui::ColorConvertU32ToFloat4(image->GetColor()));
+			else ImGui::Dummy(image_size);
 
 			const ImVec2 image_area_min = (image_area_middle - image_area / 2.0f) - ImVec2{ 1.0f, 1.0f };
 			const ImVec2 image_area_max = image_area_min + image_area + ImVec2{ 2.0f, 2.0f };
@@ -109,8 +372,20 @@ namespace UI
 
 			ImGui::SameLine();
 
+			// Images still decoding in the background show their progress, removing them cancels the decode
+			const char* remove_label = image->IsPlaceholder() ? "Cancel" : "Remove";
+			if (image->IsLoading())
+			{
+				const float remove_width = ImGui::CalcTextSize(remove_label).x + ImGui::GetStyle().FramePadding.x * 2.0f;
+				const float progress_width = ImGui::GetContentRegionAvail().x - remove_width - ImGui::GetStyle().ItemSpacing.x;
+
+				ImGui::SetCursorPosY(button_pos_y);
+				ImGui::ProgressBar(image->GetLoadingProgress(), { progress_width, 0.0f }, "Loading...");
+				ImGui::SameLine();
+			}
+
 			ImGui::SetCursorPosY(button_pos_y);
-			if (ButtonRightAlign("Remove"))
+			if (ButtonRightAlign(remove_label))
 			{
 				Image::images.erase(Image::images.begin() + static_cast<int64_t>(i));
 				--i;
@@ -169,6 +444,14 @@ namespace UI
 			if (ImGui::BeginPopupModal("Select canvas image", nullptr, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoSavedSettings))
 			{
 				static float scaling = 1.0f;
+				static ImageResize::Settings resize_settings;
+
+				if (ImGui::Button("Open layout"))
+				{
+					OpenLayout();
+					if (Image::canvas) ImGui::CloseCurrentPopup();
+				}
+				ImGui::SameLine();
 
 				if (ImGui::Button("Choose canvas image"))
 				{
@@ -181,7 +464,10 @@ namespace UI
 					}
 				}
 
+				if (start_selected_image) start_selected_image->UpdateTextures();
+
 				const bool image_selection_valid{ start_selected_image };
+				const bool image_loading = image_selection_valid && start_selected_image->IsLoading();
 
 				ImVec2 resolution{};
 				ImVec2 scaled_resolution{};
@@ -195,7 +481,15 @@ namespace UI
 					const ImVec2 image_size = GetImageDrawSize(start_selected_image->GetWidth(), start_selected_image->GetHeight(), avail_size);
 
 					ImGui::SetCursorPosX(avail_size.x / 2.0f - image_size.x / 2.0f);
-					ImGui::Image(start_selected_image->GetTexture(), image_size);
+					if (SDL_Texture* preview = start_selected_image->GetPreviewTexture(image_size.x)) ImGui::ImageWithBg(preview, image_size, { 0.0f, 0.0f }, { 1.0f, 1.0f }, {}, ImGui::ColorConvertU32ToFloat4(start_selected_image->GetColor()));
+					else ImGui::Dummy(image_size);
+
+					if (image_loading)
+					{
+						ImGui::ProgressBar(start_selected_image->GetLoadingProgress(), { -ImGui::CalcTextSize("Cancel").x - ImGui::GetStyle().FramePadding.x * 2.0f - ImGui::GetStyle().ItemSpacing.x, 0.0f }, "Loading...");
+						ImGui::SameLine();
+						if (ImGui::Button("Cancel")) start_selected_image.reset();
+					}
 				}
 
 				ImGui::BeginDisabled(!image_selection_valid);
@@ -205,10 +499,16 @@ namespace UI
 
 				ImGui::Text("Scaled resolution: %.0f x %.0f", scaled_resolution.x, scaled_resolution.y);
 
+				// The preview above is just stretched by the GPU, these only apply to the canvas that gets created
+				ImGui::BeginDisabled(scaling == 1.0f);
+				Image::ResizeSettingsUI(resize_settings);
+				ImGui::EndDisabled();
+
+				ImGui::BeginDisabled(image_loading);
 				if (ImGui::Button("Select"))
 				{
 					if (scaling == 1.0f) Image::canvas = std::make_unique<Image::Canvas>(std::move(*start_selected_image));
-					else Image::canvas = std::make_unique<Image::Canvas>(start_selected_path, scaling);
+					else Image::canvas = std::make_unique<Image::Canvas>(start_selected_path, scaling, resize_settings);
 
 					start_selected_image.reset();
 
@@ -216,6 +516,7 @@ namespace UI
 					else Image::canvas.reset();
 				}
 				ImGui::EndDisabled();
+				ImGui::EndDisabled();
 
 				ImGui::EndPopup();
 			}
@@ -246,23 +547,9 @@ namespace UI
 
 				if (ImGui::IsMouseClicked(ImGuiMouseButton_Left))
 				{
-					bool clicked_image = false;
-					for (size_t i = Image::images.size() - 1; i < Image::images.size(); i--)
-					{
-						const auto& image = Image::images.at(i);
-
-						const SDL_FRect image_rect = image->GetScreenRect();
-						const SDL_FPoint mouse_position = ImGui::GetMousePos();
-
-						clicked_image |= SDL_PointInRectFloat(&mouse_position, &image_rect);
-						if (clicked_image)
-						{
-							Image::selection_index = i;
-							break;
-						}
-					}
-
-					if (!clicked_image) Image::ResetSelection();
+					const std::optional<size_t> clicked_image = Image::canvas->FindLayerAt(ImGui::GetMousePos());
+					if (clicked_image) Image::selection_index = *clicked_image;
+					else Image::ResetSelection();
 				}
 				if (ImGui::IsMouseClicked(ImGuiMouseButton_Middle)) dragging = true;
 
@@ -306,6 +593,9 @@ namespace UI
 
 			if (ImGui::IsMouseReleased(ImGuiMouseButton_Middle) || ImGui::IsMouseReleased(ImGuiMouseButton_Left)) dragging = false;
 
+			const bool dragging_selection = dragging && Image::IsSelectionValid() && ImGui::IsMouseDown(ImGuiMouseButton_Left);
+			Image::canvas->SetDraggedLayer(dragging_selection ? Image::GetSelection().get() : nullptr);
+
 			Renderer::scroll.x = ImGui::GetScrollX();
 			Renderer::scroll.y = ImGui::GetScrollY();
 		}
@@ -345,139 +635,171 @@ namespace UI
 		ImGui_ImplSDL3_ProcessEvent(event);
 	}
 
-	std::future<void> export_future;
-
-	void Update(SDL_Renderer* renderer)
+	namespace
 	{
-		ImGui_ImplSDLRenderer3_NewFrame();
-		ImGui_ImplSDL3_NewFrame();
-		ImGui::NewFrame();
+		ImageExport::Settings export_settings;
+		float export_scale{ 1.0f };
 
-		if (!Image::canvas)
+		void BuildFrame(SDL_Renderer* renderer)
 		{
-			CanvasImageSelect();
-
-			ImGui::Render();
-			ImGui_ImplSDLRenderer3_RenderDrawData(ImGui::GetDrawData(), renderer);
-			return;
-		}
+			if (!Image::canvas)
+			{
+				CanvasImageSelect();
+				return;
+			}
 
-		if (ImGui::BeginMainMenuBar())
-		{
-			if (ImGui::MenuItem("Export"))
+			if (ImGui::BeginMainMenuBar())
 			{
-				const std::filesystem::path result = pfd::save_file{ "Export png", "", {"PNG image", "*.png"} }.result();
-				if (!result.empty())
+				LayoutMenu();
+				EditMenu();
+				ViewMenu();
+
+				if (ImGui::BeginMenu("Export"))
 				{
-					export_future = Image::canvas->Export(result.generic_string());
+					if (ImGui::MenuItem("Export..."))
+					{
+						std::filesystem::path result = pfd::save_file{ "Export image", "", GetExportFilters(export_settings.format) }.result();
+						if (!result.empty())
+						{
+							// Picking another format in the dialog overrides the one selected here
+							ImageExport::Settings settings = export_settings;
+							settings.format = ImageExport::GetFormat(result.string(), export_settings.format);
+							if (!result.has_extension()) result += ImageExport::FORMAT_EXTENSIONS.at(static_cast<size_t>(settings.format));
+
+							Image::canvas->Export(ExportQueue::CreateJob(result.generic_string(), settings, export_scale));
+						}
+					}
+
+					ExportSettingsUI(export_settings);
+
+					ImGui::SliderFloat("Scale", &export_scale, 0.1f, 4.0f, "%.2f", ImGuiSliderFlags_Logarithmic | ImGuiSliderFlags_ClampOnInput);
+					ImGui::TextDisabled("Exported resolution: %.0f x %.0f", std::max<float>(export_scale * static_cast<float>(Image::canvas->image.GetWidth()), 1.0f),
+						std::max<float>(export_scale * static_cast<float>(Image::canvas->image.GetHeight()), 1.0f));
+
+					ImGui::EndMenu();
 				}
-			}
 
-			ImGui::EndMainMenuBar();
-		}
+				ImGui::EndMainMenuBar();
+			}
 
-		int render_height;
-		if (!SDL_GetCurrentRenderOutputSize(renderer, nullptr, &render_height))
-			std::cout << "Failed to get the renderer height: " << SDL_GetError() << '\n';
+			int render_height;
+			if (!SDL_GetCurrentRenderOutputSize(renderer, nullptr, &render_height))
+				std::cout << "Failed to get the renderer height: " << SDL_GetError() << '\n';
 
-		constexpr ImGuiWindowFlags edit_window_flags =
-			ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoBackground |
-			ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoBringToFrontOnFocus |
-			ImGuiWindowFlags_AlwaysVerticalScrollbar | ImGuiWindowFlags_AlwaysHorizontalScrollbar | ImGuiWindowFlags_NoNav;
+			constexpr ImGuiWindowFlags edit_window_flags =
+				ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoBackground |
+				ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoBringToFrontOnFocus |
+				ImGuiWindowFlags_AlwaysVerticalScrollbar | ImGuiWindowFlags_AlwaysHorizontalScrollbar | ImGuiWindowFlags_NoNav;
 
-		// Window position and height are offset with the frame height to account for the main menu bar at the top
-		ImGui::SetNextWindowPos(ImVec2{ 0.0f, ImGui::GetFrameHeight() });
-		ImGui::SetNextWindowSize(working_area + ImVec2{ 0.0f, ImGui::GetStyle().ScrollbarSize });
+			// Window position and height are offset with the frame height to account for the main menu bar at the top
+			ImGui::SetNextWindowPos(ImVec2{ 0.0f, ImGui::GetFrameHeight() });
+			ImGui::SetNextWindowSize(working_area + ImVec2{ 0.0f, ImGui::GetStyle().ScrollbarSize });
 
-		// Sets the content size, this is so we can use the imgui scrollbars since its convenient
-		ImGui::SetNextWindowContentSize(Image::canvas->content_size);
+			// Sets the content size, this is so we can use the imgui scrollbars since its convenient
+			ImGui::SetNextWindowContentSize(Image::canvas->content_size);
 
-		ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, { 0.0f, 0.0f });
-		if (ImGui::Begin("##Editor window", nullptr, edit_window_flags))
-		{
-			// Hacky work around to center the view one time after selecting a canvas image
-			if (!has_center_view && working_area.x * working_area.y != 0.0f)
+			ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, { 0.0f, 0.0f });
+			if (ImGui::Begin("##Editor window", nullptr, edit_window_flags))
 			{
-				ImGui::SetScrollX(ImGui::GetScrollMaxX() / 2.0f);
-				ImGui::SetScrollY(ImGui::GetScrollMaxY() / 2.0f);
+				// Hacky work around to center the view one time after selecting a canvas image
+				if (!has_center_view && working_area.x * working_area.y != 0.0f)
+				{
+					ImGui::SetScrollX(ImGui::GetScrollMaxX() / 2.0f);
+					ImGui::SetScrollY(ImGui::GetScrollMaxY() / 2.0f);
 
-				has_center_view = true;
-			}
+					has_center_view = true;
+				}
 
-			EditorInput();
-		}
-		ImGui::End();
-		ImGui::PopStyleVar();
+				EditorInput();
+			}
+			ImGui::End();
+			ImGui::PopStyleVar();
 
 
-		const ImVec2 items_window_offset = ImVec2{ ImGui::GetFontSize(), ImGui::GetFontSize() } *3.0f;
-		const ImVec2 items_window_size = ImVec2{ 30.0f, 22.5f } *ImGui::GetFontSize();
+			const ImVec2 items_window_offset = ImVec2{ ImGui::GetFontSize(), ImGui::GetFontSize() } *3.0f;
+			const ImVec2 items_window_size = ImVec2{ 30.0f, 22.5f } *ImGui::GetFontSize();
 
-		ImGui::SetNextWindowPos(ImGui::GetMainViewport()->Size - items_window_offset, ImGuiCond_FirstUseEver, ImVec2{ 1.0f, 1.0f });
-		ImGui::SetNextWindowSize(items_window_size, ImGuiCond_FirstUseEver);
-		if (ImGui::Begin("Image items", nullptr, ImGuiWindowFlags_MenuBar))
-		{
-			if (ImGui::BeginMenuBar())
+			ImGui::SetNextWindowPos(ImGui::GetMainViewport()->Size - items_window_offset, ImGuiCond_FirstUseEver, ImVec2{ 1.0f, 1.0f });
+			ImGui::SetNextWindowSize(items_window_size, ImGuiCond_FirstUseEver);
+			if (ImGui::Begin("Image items", nullptr, ImGuiWindowFlags_MenuBar))
 			{
-				AddImageMenu();
+				if (ImGui::BeginMenuBar())
+				{
+					AddImageMenu();
+
+					ImGui::EndMenuBar();
+				}
+
+				for (size_t i = Image::images.size() - 1; i < Image::images.size(); i--)
+				{
+					ImGui::PushID(static_cast<int>(i));
 
-				ImGui::EndMenuBar();
+					ImageSelection(i);
+
+					ImGui::PopID();
+				}
 			}
+			ImGui::End();
+
+			const ImVec2 selection_window_offset = ImVec2{ -ImGui::GetFontSize(), ImGui::GetFontSize() } *3.0f + ImVec2{ ImGui::GetStyle().ScrollbarSize, 0.0f };
+			const ImVec2 selection_window_size = ImVec2{ 30.0f, 40.0f } *ImGui::GetFontSize();
 
-			for (size_t i = Image::images.size() - 1; i < Image::images.size(); i--)
+			ImGui::SetNextWindowPos(ImVec2{ 0.0f, ImGui::GetMainViewport()->Size.y } - selection_window_offset, ImGuiCond_FirstUseEver, ImVec2{ 0.0f, 1.0f });
+			ImGui::SetNextWindowSize(selection_window_size, ImGuiCond_FirstUseEver);
+			if (ImGui::Begin("Selected image"))
 			{
-				ImGui::PushID(static_cast<int>(i));
+				SelectedTextMenu();
+			}
+			ImGui::End();
 
-				ImageSelection(i);
+			ExportsWindow();
+			if (show_profiler) ProfilerWindow(show_profiler);
 
-				ImGui::PopID();
-			}
-		}
-		ImGui::End();
+			working_area = ImGui::GetMainViewport()->Size;
+			working_area.y -= ImGui::GetFrameHeight() + ImGui::GetStyle().ScrollbarSize;
 
-		const ImVec2 selection_window_offset = ImVec2{ -ImGui::GetFontSize(), ImGui::GetFontSize() } *3.0f + ImVec2{ ImGui::GetStyle().ScrollbarSize, 0.0f };
-		const ImVec2 selection_window_size = ImVec2{ 30.0f, 40.0f } *ImGui::GetFontSize();
+			Image::canvas->UpdateScaleAndOffset(working_area, ImGui::GetFrameHeight());
 
-		ImGui::SetNextWindowPos(ImVec2{ 0.0f, ImGui::GetMainViewport()->Size.y } - selection_window_offset, ImGuiCond_FirstUseEver, ImVec2{ 0.0f, 1.0f });
-		ImGui::SetNextWindowSize(selection_window_size, ImGuiCond_FirstUseEver);
-		if (ImGui::Begin("Selected image"))
-		{
-			SelectedTextMenu();
+			// Drags and held buttons only become a step once they're let go, so a whole drag is undone at once
+			HistoryShortcuts();
+			History::Update(ImGui::IsAnyItemActive() || ImGui::IsMouseDown(ImGuiMouseButton_Left) || ImGui::IsMouseDown(ImGuiMouseButton_Right));
 		}
-		ImGui::End();
-
-		if (!ImGui::IsPopupOpen("Exporting") && export_future.valid()) ImGui::OpenPopup("Exporting");
+	}
 
-		ImGui::SetNextWindowSize(ImGui::GetMainViewport()->Size / ImVec2{ 6.0f, 4.0f });
-		ImGui::SetNextWindowPos(ImVec2{ ImGui::GetMainViewport()->Size / 2.0f - ImGui::GetCurrentContext()->NextWindowData.SizeVal / 2.0f });
-		if (ImGui::BeginPopupModal("Exporting", nullptr, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoSavedSettings))
+	void Update(SDL_Renderer* renderer)
+	{
 		{
-			const std::string text = "Exporting image...";
-			const ImVec2 text_size = ImGui::CalcTextSize(text.c_str());
+			const Profiler::ScopedTimer timer{ Profiler::Stage::UI };
 
-			ImGui::SetCursorPos(ImGui::GetContentRegionAvail() / 2.0f - text_size / 2.0f);
-			ImGui::Text("%s", text.c_str());
+			ImGui_ImplSDLRenderer3_NewFrame();
+			ImGui_ImplSDL3_NewFrame();
+			ImGui::NewFrame();
 
-			if (export_future.wait_for(seconds{ 0 }) == std::future_status::ready)
-			{
-				export_future.get();
-				ImGui::CloseCurrentPopup();
-			}
+			BuildFrame(renderer);
 
-			ImGui::EndPopup();
+			ImGui::Render();
 		}
 
-		working_area = ImGui::GetMainViewport()->Size;
-		working_area.y -= ImGui::GetFrameHeight() + ImGui::GetStyle().ScrollbarSize;
+		const Profiler::ScopedTimer timer{ Profiler::Stage::ImGuiRender };
+		ImGui_ImplSDLRenderer3_RenderDrawData(ImGui::GetDrawData(), renderer);
+	}
 
-		Image::canvas->UpdateScaleAndOffset(working_area, ImGui::GetFrameHeight());
+	int GetIdleTimeout()
+	{
+		const bool loading = (Image::canvas && Image::canvas->image.IsLoading()) || std::ranges::any_of(Image::images, [](const auto& image) { return image->IsLoading(); });
+		const bool exporting = std::ranges::any_of(ExportQueue::GetJobs(), [](const auto& job) { return !job->IsDone(); });
+		if (loading || exporting) return PROGRESS_REFRESH_MS;
 
-		ImGui::Render();
-		ImGui_ImplSDLRenderer3_RenderDrawData(ImGui::GetDrawData(), renderer);
+		if (ImGui::GetIO().WantTextInput) return CURSOR_BLINK_MS;
+
+		return -1;
 	}
 
 	void Exit()
 	{
+		// Exports run on their own threads, the files would be cut off if we quit while they're still writing
+		ExportQueue::WaitForAll();
+
 		ImGui_ImplSDLRenderer3_Shutdown();
 		ImGui_ImplSDL3_Shutdown();
 
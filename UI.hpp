@@ -7,10 +7,25 @@ union SDL_Event;
 
 namespace UI
 {
+	// How the main loop paces itself
+	struct FrameSettings
+	{
+		// Waits for input (or for work to finish) instead of drawing every frame while nothing changes
+		bool idle{ true };
+
+		// Frames per second while drawing, 0 leaves it up to vsync
+		int max_fps{ 0 };
+	};
+
+	inline FrameSettings frame_settings;
+
 	void UpdateScale();
 
 	void Setup();
 	void ProcessEvents(const SDL_Event* event);
 	void Update(SDL_Renderer* renderer);
+
+	// Milliseconds the UI can go without being drawn again when there is no input, -1 when only input changes it
+	[[nodiscard]] int GetIdleTimeout();
 	void Exit();
 }
\ No newline at end of file